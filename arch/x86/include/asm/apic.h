@@ -203,7 +203,13 @@ int apic_calibration(void);
 int apic_is_enabled(void);
 int apic_enable_timer(void);
 int apic_disable_timer(void);
+int apic_timer_deadline(uint32_t usecs);
 int ioapic_inton(uint8_t irq, uint8_t apicid);
+int apic_send_ipi(uint32_t core_id, uint8_t vector);
+int apic_core_online(uint32_t core_id);
+#if MAX_CORES > 1
+int smp_init(void);
+#endif
 int ioapic_intoff(uint8_t irq, uint8_t apicid);
 int map_apic(void);
 
@@ -160,6 +160,64 @@ inline static void atomic_int32_set(atomic_int32_t *d, int32_t v) {
 	atomic_int32_test_and_set(d, v);
 }
 
+/** @brief Atomically set a bit in a bitmap
+ *
+ * @param nr Number of the bit, which will be set
+ * @param addr Start address of the bitmap
+ */
+inline static void atomic_set_bit(size_t nr, volatile size_t* addr)
+{
+	asm volatile(LOCK "bts %1, %0" : "+m"(*addr) : "r"(nr) : "memory", "cc");
+}
+
+/** @brief Atomically clear a bit in a bitmap and return its old value
+ *
+ * @param nr Number of the bit, which will be cleared
+ * @param addr Start address of the bitmap
+ *
+ * @return The old value of the bit
+ */
+inline static int atomic_test_and_clear_bit(size_t nr, volatile size_t* addr)
+{
+	uint8_t ret;
+
+	asm volatile(LOCK "btr %2, %1; setc %0" : "=q"(ret), "+m"(*addr) : "r"(nr) : "memory", "cc");
+
+	return ret;
+}
+
+/** @brief Read a value with acquire semantics
+ *
+ * x86 doesn't reorder a load with later loads and stores.
+ * Hence, a compiler barrier is sufficient.
+ *
+ * @param p Address of the value
+ * @return The value
+ */
+inline static uint32_t atomic_load_acquire(const volatile uint32_t* p)
+{
+	uint32_t v = *p;
+
+	asm volatile ("" ::: "memory");
+
+	return v;
+}
+
+/** @brief Write a value with release semantics
+ *
+ * x86 doesn't reorder a store with earlier loads and stores.
+ * Hence, a compiler barrier is sufficient.
+ *
+ * @param p Address of the value
+ * @param v New value
+ */
+inline static void atomic_store_release(volatile uint32_t* p, uint32_t v)
+{
+	asm volatile ("" ::: "memory");
+
+	*p = v;
+}
+
 #ifdef __cplusplus
 }
 #endif
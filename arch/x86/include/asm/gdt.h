@@ -111,10 +111,10 @@ typedef struct {
 } __attribute__ ((packed)) gdt_ptr_t;
 
 #ifdef CONFIG_X86_32
-#define GDT_ENTRIES	(5+1)
+#define GDT_ENTRIES	(5+MAX_CORES)
 #else
 // a TSS descriptor is twice larger than a code/data descriptor
-#define GDT_ENTRIES	(6+1*2)
+#define GDT_ENTRIES	(6+MAX_CORES*2)
 #endif
 
 #if GDT_ENTRIES > 8192
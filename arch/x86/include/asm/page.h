@@ -124,12 +124,62 @@ static inline size_t sign_extend(ssize_t addr, int bits)
 #define PG_GLOBAL		(1 << 8)
 /// This table is a self-reference and should skipped by page_map_copy()
 #define PG_SELF			(1 << 9)
+/// This page is shared read-only and copied on the first write access
+#define PG_COW			(1 << 10)
+/// Request for page_map(): use huge pages, where the alignment allows it (kernel space only)
+#define PG_HUGE			(1 << 11)
 
 #ifdef CONFIG_X86_64
 /// Disable execution for this page
 #define PG_XD			(1L << 63)
 #endif
 
+/// Up to this number of pages are invalidated one by one, otherwise the whole TLB is flushed
+#define TLB_BATCH_SIZE		32
+
+/** @brief Collects the TLB invalidations of a multi-page operation
+ *
+ * The page table functions add each modified entry by tlb_batch_add()
+ * and invalidate all of them at once by tlb_batch_flush().
+ */
+typedef struct {
+	/// number of collected invalidations
+	uint32_t count;
+	/// at least one kernel (global) page was modified
+	uint8_t kernel;
+	/// at least one non-global page was modified
+	uint8_t user;
+	/// addresses of the modified pages
+	size_t addr[TLB_BATCH_SIZE];
+} tlb_batch_t;
+
+/// Initializer of an empty TLB batch
+#define TLB_BATCH_INIT		{ 0, 0, 0, { 0 } }
+
+/** @brief Remember a modified page for the next tlb_batch_flush()
+ *
+ * @param batch The TLB batch
+ * @param viraddr Virtual address of the modified (huge) page
+ */
+static inline void tlb_batch_add(tlb_batch_t* batch, size_t viraddr)
+{
+	if (viraddr < KERNEL_SPACE)
+		batch->kernel = 1;
+	else
+		batch->user = 1;
+
+	if (batch->count < TLB_BATCH_SIZE)
+		batch->addr[batch->count] = viraddr;
+	batch->count++;
+}
+
+/** @brief Invalidate all pages of the batch and empty it
+ *
+ * Small batches are invalidated page by page, larger ones
+ * by flushing the whole TLB.
+ */
+void tlb_batch_flush(tlb_batch_t* batch);
+
 /** @brief Converts a virtual address to a physical
  *
  * A non mapped virtual address causes a pagefault!
@@ -158,6 +208,16 @@ int page_init(void);
  */
 int page_map(size_t viraddr, size_t phyaddr, size_t npages, size_t bits);
 
+/** @brief Map a continuous region of pages to scattered page frames
+ *
+ * @param viraddr Desired virtual address
+ * @param frames Physical addresses of the page frames (one per page)
+ * @param npages The region's size in number of pages
+ * @param bits Further page flags (PG_HUGE is ignored)
+ * @return
+ */
+int page_map_frames(size_t viraddr, const size_t* frames, size_t npages, size_t bits);
+
 /** @brief Unmap a continuous region of pages
  *
  * @param viraddr The virtual start address
@@ -181,15 +241,31 @@ int page_unmap(size_t viraddr, size_t npages);
  */
 int page_set_flags(size_t viraddr, uint32_t npages, int flags);
 
+/** @brief Fill a page frame with zeros
+ *
+ * The page frame is mapped into a per-core window and cleared by
+ * non-temporal stores, which don't evict the caches.
+ *
+ * @param phyaddr Physical address of the page frame
+ */
+void page_zero(size_t phyaddr);
+
 /** @brief Copy a whole page map tree
  *
  * @param dest Physical address of new page map
  * @retval 0 Success. Everything went fine.
- * @retval <0 Error. Something went wrong.
+ * @retval <0 Error. The copied tables are already released again.
  */
 int page_map_copy(struct task *dest);
 
 /** @brief Free a whole page map tree */
 int page_map_drop(void);
 
+/** @brief Load the page map of a task on the current core
+ *
+ * If process-context identifiers are available, the TLB entries
+ * are tagged by the task id and survive the context switch.
+ */
+void page_map_switch(struct task *task);
+
 #endif
@@ -64,6 +64,7 @@ extern "C" {
 #define CPU_FEATURE_SSE2		(1 << 26)
 
 // feature list 2
+#define CPU_FEATURE_PCID		(1 << 17)
 #define CPU_FEATURE_X2APIC		(1 << 21)
 #define CPU_FEATURE_AVX			(1 << 28)
 #define CPU_FEATURE_HYPERVISOR	(1 << 31)
@@ -74,6 +75,9 @@ extern "C" {
 #define CPU_FEATURE_1GBHP		(1 << 26)
 #define CPU_FEATURE_LM			(1 << 29)
 
+// CPUID.07H:EBX feature list
+#define CPU_FEATURE_INVPCID		(1 << 10)
+
 // x86 control registers
 
 /// Protected Mode Enable
@@ -99,6 +103,13 @@ extern "C" {
 /// Enable paging
 #define CR0_PG					(1 << 31)
 
+#ifdef CONFIG_X86_64
+/// Process-context identifier (if CR4.PCIDE is set)
+#define CR3_PCID				0xFFFUL
+/// Keep the TLB entries of the new process-context identifier
+#define CR3_NOFLUSH				(1UL << 63)
+#endif
+
 /// Virtual 8086 Mode Extensions
 #define CR4_VME					(1 << 0)
 /// Protected-mode Virtual Interrupts
@@ -165,8 +176,12 @@ extern "C" {
 #define EFER_FFXSR				(1 << 14)
 #define EFER_TCE				(1 << 15)
 
+// EFLAGS bits
+/// Interrupt enable flag
+#define EFLAGS_IF				(1 << 9)
+
 typedef struct {
-	uint32_t feature1, feature2, feature3;
+	uint32_t feature1, feature2, feature3, feature4;
 	uint32_t addr_width;
 } cpu_info_t;
 
@@ -225,6 +240,21 @@ inline static uint32_t has_nx(void)
 	return (cpu_info.feature3 & CPU_FEATURE_NX);
 }
 
+inline static uint32_t has_1gbhp(void)
+{
+	return (cpu_info.feature3 & CPU_FEATURE_1GBHP);
+}
+
+inline static uint32_t has_pcid(void)
+{
+	return (cpu_info.feature2 & CPU_FEATURE_PCID);
+}
+
+inline static uint32_t has_invpcid(void)
+{
+	return (cpu_info.feature4 & CPU_FEATURE_INVPCID);
+}
+
 /** @brief Read out time stamp counter
  *
  * The rdtsc asm command puts a 64 bit time stamp value
@@ -379,6 +409,49 @@ static inline void tlb_flush_one_page(size_t addr)
 	asm volatile("invlpg (%0)" : : "r"(addr) : "memory");
 }
 
+#ifdef CONFIG_X86_64
+/// INVPCID: invalidate all entries of all PCIDs, including global entries
+#define INVPCID_ALL_GLOBAL	2
+
+/** @brief Invalidate TLB entries tagged by process-context identifiers
+ * @param type INVPCID type (e.g. INVPCID_ALL_GLOBAL)
+ * @param pcid The affected process-context identifier
+ * @param addr The affected (virtual) address
+ */
+static inline void invpcid(size_t type, size_t pcid, size_t addr)
+{
+	struct {
+		uint64_t pcid;
+		uint64_t addr;
+	} desc = { pcid, addr };
+
+	asm volatile("invpcid %1, %0" : : "r"(type), "m"(desc) : "memory");
+}
+#endif
+
+/** @brief Flush the whole TLB, including the global entries
+ *
+ * Uses INVPCID, if available. Otherwise, toggling CR4.PGE flushes
+ * all entries of all process-context identifiers.
+ */
+static inline void flush_tlb_global(void)
+{
+	size_t cr4;
+
+#ifdef CONFIG_X86_64
+	if (has_invpcid()) {
+		invpcid(INVPCID_ALL_GLOBAL, 0, 0);
+		return;
+	}
+#endif
+
+	cr4 = read_cr4();
+	if (cr4 & CR4_PGE) {
+		write_cr4(cr4 & ~CR4_PGE);
+		write_cr4(cr4);
+	} else flush_tlb();
+}
+
 /** @brief Invalidate cache
  *
  * The invd asm instruction which invalidates cache without writing back
@@ -473,6 +546,18 @@ static inline size_t lsb(size_t i)
 /// The HALT instruction stops the processor until the next interrupt arrives 
 #define HALT	asm volatile ("hlt")
 
+#if MAX_CORES > 1
+/** @brief Process a pending TLB shootdown of this core
+ *
+ * Loops, which wait with disabled interrupts, call this function.
+ * Otherwise, they would never acknowledge the IPI of a core, which
+ * holds the awaited lock and waits for the shootdown.
+ */
+void tlb_shootdown_poll(void);
+#else
+static inline void tlb_shootdown_poll(void) {}
+#endif
+
 /** @brief Init several subsystems
  *
  * This function calls the initialization procedures for:
@@ -515,7 +600,8 @@ void udelay(uint32_t usecs);
 
 /** @brief System calibration
  *
- * This procedure will detect the CPU frequency and calibrate the APIC timer.
+ * This procedure will detect the CPU frequency, calibrate the APIC timer
+ * and boot the application processors.
  *
  * @return 0 in any case.
  */
@@ -525,6 +611,9 @@ inline static int system_calibration(void)
 	irq_enable();
 	detect_cpu_frequency();
 	apic_calibration();
+#if MAX_CORES > 1
+	smp_init();
+#endif
 
 	return 0;
 }
@@ -140,6 +140,18 @@ char* strncpy(char* dest, const char* src, size_t n);
 char* strcpy(char* dest, const char* src);
 #endif
 
+/** @brief Copy n bytes, which may fault
+ *
+ * A page fault, which the page fault handler isn't able to resolve,
+ * aborts the copy instead of halting the kernel.
+ *
+ * @param dest Destination pointer
+ * @param src Source pointer
+ * @param n number of bytes to copy
+ * @return number of bytes, which aren't copied
+ */
+size_t copy_user(void* dest, const void* src, size_t n);
+
 #ifdef __cplusplus
 }
 #endif
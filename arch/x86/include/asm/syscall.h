@@ -51,6 +51,9 @@ extern "C" {
  * It's supposed to be used by the macros defined in this file as the could would read
  * cleaner then.
  *
+ * On x86_64, the syscall instruction is used. The number is passed in rax,
+ * the arguments in rdi, rsi, rdx, r10 and r8.
+ *
  * @param nr System call number
  * @param arg0 Argument 0
  * @param arg1 Argument 1
@@ -79,11 +82,13 @@ syscall(int nr, unsigned long arg0, unsigned long arg1, unsigned long arg2,
 	unsigned long arg3, unsigned long arg4)
 {
 	long res;
+	register unsigned long r10 asm("r10") = arg3;
+	register unsigned long r8 asm("r8") = arg4;
 
-	asm volatile ("mov %5, %%r8; mov %6, %%r9; syscall"
+	asm volatile ("syscall"
 			: "=a" (res)
-			: "D" (nr), "S" (arg0), "d" (arg1), "c" (arg2), "m" (arg3), "m" (arg4)
-			: "memory", "cc", "%r8", "%r9");
+			: "0" (nr), "D" (arg0), "S" (arg1), "d" (arg2), "r" (r10), "r" (r8)
+			: "memory", "cc", "%rcx", "%r11");
 
 	return res;
 }
@@ -38,11 +38,28 @@
 #define __ASM_TASKS_H__
 
 #include <eduos/stddef.h>
+#include <asm/processor.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#ifdef CONFIG_X86_64
+/** @brief Stacks of the syscall instruction
+ *
+ * MSR_KERNEL_GS_BASE points to the entry of the current core. isrsyscall
+ * loads the kernel stack by swapgs, before it touches any stack.
+ */
+typedef struct {
+	/// top of the kernel stack of the current task (see set_kernel_stack())
+	size_t kernel_rsp;
+	/// user stack pointer, saved by isrsyscall
+	size_t user_rsp;
+} __attribute__ ((aligned (CACHE_LINE))) syscall_stack_t;
+
+extern syscall_stack_t syscall_stacks[MAX_CORES];
+#endif
+
 /**
  * @brief Switch to current task
  *
@@ -61,7 +78,7 @@ void switch_context(size_t** stack);
  */
 int create_default_frame(task_t* task, entry_point_t ep, void* arg);
 
-/** @brief Register a task's TSS at GDT
+/** @brief Register the TSS of the current core at GDT
  *
  * @return
  * - 0 on success
@@ -69,13 +86,17 @@ int create_default_frame(task_t* task, entry_point_t ep, void* arg);
 static inline int register_task(void)
 {
 #ifdef CONFIG_X86_32
-	uint16_t sel = 5 << 3;
+	uint16_t sel = (5 + CORE_ID) << 3;
 #else
-	uint16_t sel = 6 << 3;
+	uint16_t sel = (6 + CORE_ID*2) << 3;
 #endif
 
 	asm volatile ("ltr %%ax" : : "a"(sel));
 
+#ifdef CONFIG_X86_64
+	wrmsr(MSR_KERNEL_GS_BASE, (size_t) (syscall_stacks + CORE_ID));
+#endif
+
 	return 0;
 }
 
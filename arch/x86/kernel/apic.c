@@ -34,6 +34,7 @@
 #include <eduos/time.h>
 #include <eduos/spinlock.h>
 #include <eduos/vma.h>
+#include <eduos/tasks.h>
 #include <asm/irq.h>
 #include <asm/idt.h>
 #include <asm/irqflags.h>
@@ -74,6 +75,28 @@ static uint8_t irq_redirect[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0xA, 0xB, 0xC,
 static uint8_t initialized = 0;
 spinlock_t bootlock = SPINLOCK_INIT;
 
+#if MAX_CORES > 1
+/// maps the APIC id of a processor to its logical core id
+static uint8_t apic_core_id[256] = {[0 ... 255] = 0};
+/// number of online cores
+static atomic_int32_t cpu_online = ATOMIC_INIT(1);
+/// cores, which are able to receive IPIs
+static volatile uint8_t core_online[MAX_CORES] = {[0 ... MAX_CORES-1] = 0};
+
+/*
+ * Boot code of the application processors and its parameters,
+ * which are defined in entry.asm
+ */
+extern const void smp_trampoline;
+extern const void smp_trampoline_end;
+extern const void smp_cr3;
+extern const void smp_stack;
+extern const void boot_stack;
+
+// idle loop of the application processors
+extern int smp_main(void);
+#endif
+
 // forward declaration
 static int lapic_reset(void);
 
@@ -157,12 +180,26 @@ int apic_is_enabled(void)
 
 uint32_t apic_cpu_id(void)
 {
-	if (apic_is_enabled())
+	if (apic_is_enabled()) {
+		// in x2APIC mode, the register contains the whole id
+		if (lapic_read == lapic_read_msr)
+			return lapic_read(APIC_ID);
 		return ((lapic_read(APIC_ID)) >> 24);
+	}
 
 	return 0;
 }
 
+#if MAX_CORES > 1
+uint32_t smp_id(void)
+{
+	if (!apic_is_enabled())
+		return 0;
+
+	return apic_core_id[apic_cpu_id() & 0xFF];
+}
+#endif
+
 static inline void apic_set_cpu_id(uint32_t id)
 {
 	if (apic_is_enabled())
@@ -208,6 +245,31 @@ int apic_enable_timer(void)
 	return -EINVAL;
 }
 
+int apic_timer_deadline(uint32_t usecs)
+{
+	uint64_t count;
+
+	if (BUILTIN_EXPECT(!apic_is_enabled() || !icr, 0))
+		return -EINVAL;
+
+	// an initial count of zero stops the one-shot timer
+	if (!usecs) {
+		lapic_write(APIC_ICR, 0);
+		return 0;
+	}
+
+	// icr is the number of APIC timer clocks per tick
+	count = ((uint64_t) usecs * icr) / TIMESLICE_USEC;
+	if (!count)
+		count = 1;
+	else if (count > 0xFFFFFFFFULL)
+		count = 0xFFFFFFFFULL;
+
+	lapic_write(APIC_ICR, (uint32_t) count);
+
+	return 0;
+}
+
 static apic_mp_t* search_mptable(size_t base, size_t limit) {
 	size_t ptr=PAGE_CEIL(base), vptr=0;
 	apic_mp_t* tmp;
@@ -259,8 +321,8 @@ static int lapic_reset(void)
 	lapic_write(APIC_TPR, 0x00);	// allow all interrupts
 	if (icr) {
 		lapic_write(APIC_DCR, 0xB);		// set it to 1 clock increments
-		lapic_write(APIC_LVT_T, 0x2007B);	// connects the timer to 123 and enables it
-		lapic_write(APIC_ICR, icr);
+		lapic_write(APIC_LVT_T, 0x7B);		// connects the timer in one-shot mode to 123
+		lapic_write(APIC_ICR, 0);		// timer is armed by timer_reprogram()
 	} else
 		lapic_write(APIC_LVT_T, 0x10000);	// disable timer interrupt
 	if (max_lvt >= 4)
@@ -315,6 +377,9 @@ int apic_calibration(void)
 
 	kprintf("APIC calibration determines an ICR of 0x%x\n", icr);
 
+	// from now on, the APIC timer is only armed if an event is due
+	timer_oneshot_init();
+
 	flags = irq_nested_disable();
 
 	if (ioapic) {
@@ -440,6 +505,22 @@ found_mp:
 	}
 	kprintf("Found %u cores\n", count);
 
+#if MAX_CORES > 1
+	// the boot processor is always core 0
+	if ((boot_processor < MAX_CORES) && (boot_processor != 0)) {
+		const apic_processor_entry_t* tmp = apic_processors[0];
+
+		apic_processors[0] = apic_processors[boot_processor];
+		apic_processors[boot_processor] = tmp;
+		boot_processor = 0;
+	}
+
+	for(i=0; i<MAX_CORES; i++) {
+		if (apic_processors[i])
+			apic_core_id[apic_processors[i]->id] = i;
+	}
+#endif
+
 	if (count > MAX_CORES) {
 		kputs("Found too many cores! Increase the macro MAX_CORES!\n");
 		goto no_mp;
@@ -512,11 +593,159 @@ int apic_init(void)
 
 	// set APIC error handler
 	irq_install_handler(126, apic_err_handler);
+#if MAX_CORES > 1
+	// the boot processor is always core 0
+	core_online[0] = 1;
+#endif
 	kprintf("Boot processor %u (ID %u)\n", boot_processor, apic_processors[boot_processor]->id);
 
 	return 0;
 }
 
+/*
+ * Write the interrupt command register and wait
+ * until the IPI is delivered
+ */
+static void apic_send_icr(uint32_t apicid, uint32_t value)
+{
+	uint8_t flags = irq_nested_disable();
+
+	if (lapic_read == lapic_read_msr) {
+		// in x2APIC mode, ICR is a single 64bit register
+		wrmsr(0x800 + (APIC_ICR1 >> 4), ((uint64_t) apicid << 32) | value);
+	} else {
+		while (lapic_read(APIC_ICR1) & APIC_ICR_BUSY)
+			PAUSE;
+
+		lapic_write(APIC_ICR2, apicid << 24);
+		lapic_write(APIC_ICR1, value);
+
+		while (lapic_read(APIC_ICR1) & APIC_ICR_BUSY)
+			PAUSE;
+	}
+
+	irq_nested_enable(flags);
+}
+
+int apic_send_ipi(uint32_t core_id, uint8_t vector)
+{
+	if (BUILTIN_EXPECT(!apic_is_enabled(), 0))
+		return -ENXIO;
+	if (BUILTIN_EXPECT((core_id >= MAX_CORES) || !apic_processors[core_id], 0))
+		return -EINVAL;
+
+	apic_send_icr(apic_processors[core_id]->id, APIC_INT_ASSERT|APIC_DM_FIXED|vector);
+
+	return 0;
+}
+
+int apic_core_online(uint32_t core_id)
+{
+#if MAX_CORES > 1
+	if (BUILTIN_EXPECT(core_id >= MAX_CORES, 0))
+		return 0;
+
+	return core_online[core_id];
+#else
+	return !core_id;
+#endif
+}
+
+#if MAX_CORES > 1
+
+/*
+ * C entry point of the application processors. The boot code in
+ * entry.asm has already enabled the paging and has set up the stack.
+ */
+void smp_start(void)
+{
+	// the application processors use the same APIC mode as the boot processor
+	if (lapic_read == lapic_read_msr)
+		wrmsr(0x1B, lapic | 0xC00);
+
+	cpu_detection();
+	idt_install();
+	lapic_reset();
+
+	// use the boot stack as stack of the idle task
+	if (BUILTIN_EXPECT(set_idle_task(), 0)) {
+		kprintf("Unable to initialize the idle task of core %u\n", CORE_ID);
+		while(1) {
+			HALT;
+		}
+	}
+
+	kprintf("Application processor %u (ID %u) is online\n", CORE_ID, apic_cpu_id());
+	atomic_int32_inc(&cpu_online);
+
+	/*
+	 * From now on, other cores shoot down kernel mappings in our TLB.
+	 * Changes before this point are flushed here.
+	 */
+	core_online[CORE_ID] = 1;
+	mb();
+	flush_tlb_global();
+
+	smp_main();
+}
+
+int smp_init(void)
+{
+	uint32_t i, j, online;
+	uint32_t* cr3;
+	size_t* stack;
+
+	if (BUILTIN_EXPECT(!apic_is_enabled(), 0))
+		return -ENXIO;
+	if (ncores <= 1)
+		return 0;
+
+	/*
+	 * Copy the boot code of the application processors to SMP_SETUP_ADDR.
+	 * The processors start in real mode at this address.
+	 */
+	if (BUILTIN_EXPECT(page_map(SMP_SETUP_ADDR, SMP_SETUP_ADDR, 1, PG_GLOBAL | PG_RW), 0))
+		return -ENOMEM;
+	memcpy((void*) SMP_SETUP_ADDR, &smp_trampoline, (size_t) &smp_trampoline_end - (size_t) &smp_trampoline);
+
+	cr3 = (uint32_t*) (SMP_SETUP_ADDR + (size_t) &smp_cr3 - (size_t) &smp_trampoline);
+	stack = (size_t*) (SMP_SETUP_ADDR + (size_t) &smp_stack - (size_t) &smp_trampoline);
+	*cr3 = (uint32_t) (read_cr3() & PAGE_MASK);
+
+	for(i=0; i<MAX_CORES; i++) {
+		if (!apic_processors[i] || (i == boot_processor))
+			continue;
+
+		// each core uses its part of boot_stack, the stack is 16byte aligned
+		*stack = (size_t) &boot_stack + (i+1) * KERNEL_STACK_SIZE - 0x10;
+		mb();
+
+		online = atomic_int32_read(&cpu_online);
+
+		// INIT-SIPI-SIPI sequence of the Intel MultiProcessor Specification
+		apic_send_icr(apic_processors[i]->id, APIC_INT_LEVELTRIG|APIC_INT_ASSERT|APIC_DM_INIT);
+		udelay(200);
+		apic_send_icr(apic_processors[i]->id, APIC_INT_LEVELTRIG|APIC_DM_INIT);
+		udelay(10000);
+		for(j=0; (j<2) && (atomic_int32_read(&cpu_online) == online); j++) {
+			apic_send_icr(apic_processors[i]->id, APIC_DM_STARTUP|(SMP_SETUP_ADDR >> PAGE_BITS));
+			udelay(200);
+		}
+
+		// wait at most one second until the core is online
+		for(j=0; (j<1000) && (atomic_int32_read(&cpu_online) == online); j++)
+			udelay(1000);
+
+		if (atomic_int32_read(&cpu_online) == online)
+			kprintf("Unable to start application processor %u (ID %u)\n", i, apic_processors[i]->id);
+	}
+
+	kprintf("%d cores are online\n", atomic_int32_read(&cpu_online));
+
+	return 0;
+}
+#endif
+
 int ioapic_inton(uint8_t irq, uint8_t apicid)
 {
 	ioapic_route_t route;
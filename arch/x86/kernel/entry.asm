@@ -244,7 +244,7 @@ L1:
 	; Set CR0
 	mov eax, cr0
 	and eax, ~(1 << 30)     ; enable caching
-	and eax, ~(1 << 16)	; allow kernel write access to read-only pages
+	or eax, (1 << 16)	; kernel writes to read-only pages fault (copy-on-write)
 	or eax, (1 << 31)       ; enable paging
 	%ifdef CONFIG_X86_64
 		or eax, (1 << 0)    ; long mode also needs PM-bit set
@@ -405,6 +405,18 @@ isrstub_pseudo_error 9
 %assign i i+1
 %endrep
 
+global wakeup
+wakeup:
+	push byte 0 ; pseudo error code
+	push byte 121
+	jmp common_stub
+
+global tlb_ipi
+tlb_ipi:
+	push byte 0 ; pseudo error code
+	push byte 122
+	jmp common_stub
+
 global apic_timer
 apic_timer:
 	push byte 0 ; pseudo error code
@@ -546,47 +558,53 @@ no_context_switch:
 %else
 
 global isrsyscall
-; used to realize system calls
+; Used to realize system calls by the syscall instruction.
+; rax contains the system call number, rdi, rsi, rdx, r10 and r8 the
+; arguments. rcx and r11 are destroyed, all other registers are preserved.
+; MSR_SYSCALL_MASK clears the interrupt flag by entering the handler.
 isrsyscall:
-	cli
-	; set kernel stack
-	extern get_kernel_stack
-	call get_kernel_stack
-	xchg rsp, rax ; => rax contains original rsp
-
-    push rax ; contains original rsp
-    push r15
-    push r14
-    push r13
-    push r12
-    push r11
-    push rbp
-    push rdx
-    push rcx
-    push rbx
-    push rdi
-    push rsi
+	; rsp is controlled by the user => switch to the kernel stack,
+	; before anything is pushed (see syscall_stack_t)
+	swapgs
+	mov [gs:8], rsp
+	mov rsp, [gs:0]
+	push QWORD [gs:8] ; original rsp
+	swapgs ; the kernel doesn't use gs
+
+	push rcx ; return address
+	push r11 ; rflags
+	push rdi
+	push rsi
+	push rdx
+	push r10
+	push r8
+	push r9
+	sub rsp, 8 ; align the stack to 16 bytes
+
+	; syscall_handler(nr, arg0, arg1, arg2, arg3, arg4)
+	mov r9, r8
+	mov r8, r10
+	mov rcx, rdx
+	mov rdx, rsi
+	mov rsi, rdi
+	mov rdi, rax
 	sti
 
-    extern syscall_handler
-    call syscall_handler
+	extern syscall_handler
+	call syscall_handler
 
 	cli
-    pop rsi
-    pop rdi
-    pop rbx
-    pop rcx
-    pop rdx
-    pop rbp
-    pop r11
-    pop r12
-    pop r13
-    pop r14
-    pop r15
-    pop r10
-    mov rsp, r10
-    sti
-    o64 sysret
+	add rsp, 8
+	pop r9
+	pop r8
+	pop r10
+	pop rdx
+	pop rsi
+	pop rdi
+	pop r11 ; rflags
+	pop rcx ; return address
+	pop rsp ; original rsp
+	o64 sysret
 
 global switch_context
 ALIGN 8
@@ -687,6 +705,120 @@ no_context_switch:
     iretq
 %endif
 
+%if MAX_CORES > 1
+; Boot code of the application processors
+;
+; The boot processor copies this code to SMP_SETUP_ADDR and sets the
+; variables smp_cr3 and smp_stack before it sends the startup IPI.
+; Therefore, all addresses are relative to SMP_SETUP_ADDR.
+%define SMP_ADDR(x) (SMP_SETUP_ADDR + ((x) - smp_trampoline))
+%ifdef CONFIG_X86_64
+%define SMP_CODE32 0x18
+%else
+%define SMP_CODE32 0x08
+%endif
+
+global smp_trampoline
+global smp_trampoline_end
+global smp_cr3
+global smp_stack
+extern smp_start
+
+ALIGN 16
+[BITS 16]
+smp_trampoline:
+	cli
+	xor ax, ax
+	mov ds, ax
+	lgdt [SMP_ADDR(smp_gdt_ptr)]
+	; enable the protected mode
+	mov eax, cr0
+	or eax, 1
+	mov cr0, eax
+	jmp dword SMP_CODE32:SMP_ADDR(smp_start32)
+
+[BITS 32]
+smp_start32:
+	mov ax, 0x10
+	mov ds, ax
+	mov es, ax
+	mov ss, ax
+	mov fs, ax
+	mov gs, ax
+	mov esp, DWORD [SMP_ADDR(smp_stack)]
+
+	; enable PSE and PAE (required by the long mode)
+	mov eax, cr4
+	or eax, (1 << 4)
+%ifdef CONFIG_X86_64
+	or eax, (1 << 5)
+%endif
+	mov cr4, eax
+
+	; use the page tables of the boot processor
+	mov eax, DWORD [SMP_ADDR(smp_cr3)]
+	mov cr3, eax
+
+%ifdef CONFIG_X86_64
+	; switch to the compatibility mode (which is part of long mode)
+	mov ecx, 0xC0000080
+	rdmsr
+	or eax, 1 << 8
+	wrmsr
+%endif
+
+	; enable caching and paging
+	mov eax, cr0
+	and eax, ~((1 << 30) | (1 << 29))
+	or eax, (1 << 16)       ; kernel writes to read-only pages fault (copy-on-write)
+	or eax, (1 << 31)
+	mov cr0, eax
+
+%ifdef CONFIG_X86_64
+	jmp 0x08:SMP_ADDR(smp_start64)
+
+[BITS 64]
+smp_start64:
+	mov rsp, QWORD [SMP_ADDR(smp_stack)]
+	; use the GDT of the kernel
+	mov rax, gdt_flush
+	call rax
+	; jump to the application processor's C code
+	mov rax, smp_start
+	call rax
+	jmp $
+%else
+	; use the GDT of the kernel
+	mov eax, gdt_flush
+	call eax
+	; jump to the application processor's C code
+	mov eax, smp_start
+	call eax
+	jmp $
+%endif
+
+ALIGN 8
+smp_gdt:
+	DQ 0x0000000000000000   ; null descriptor
+%ifdef CONFIG_X86_64
+	DQ 0x00209A0000000000   ; 64bit code descriptor
+	DQ 0x00CF92000000FFFF   ; data descriptor
+	DQ 0x00CF9A000000FFFF   ; 32bit code descriptor
+%else
+	DQ 0x00CF9A000000FFFF   ; code descriptor
+	DQ 0x00CF92000000FFFF   ; data descriptor
+%endif
+smp_gdt_ptr:
+	DW smp_gdt_ptr - smp_gdt - 1
+	DD SMP_ADDR(smp_gdt)
+ALIGN 8
+smp_cr3:
+	DQ 0
+smp_stack:
+	DQ 0
+smp_trampoline_end:
+%endif
+
 SECTION .data
 
 global mb_info:
@@ -697,7 +829,7 @@ mb_info:
 ALIGN 4096
 global boot_stack
 boot_stack:
-	TIMES (KERNEL_STACK_SIZE) DB 0xcd
+	TIMES (MAX_CORES*KERNEL_STACK_SIZE) DB 0xcd
 
 ; Bootstrap page tables are used during the initialization.
 ALIGN 4096
@@ -37,7 +37,7 @@
 #include <asm/page.h>
 
 gdt_ptr_t				gp;
-static tss_t			task_state_segment __attribute__ ((aligned (PAGE_SIZE)));
+static tss_t			task_state_segment[MAX_CORES] __attribute__ ((aligned (PAGE_SIZE)));
 // currently, our kernel has full access to the ioports
 static gdt_entry_t		gdt[GDT_ENTRIES] = {[0 ... GDT_ENTRIES-1] = {0, 0, 0, 0, 0, 0}};
 
@@ -49,20 +49,25 @@ extern void gdt_flush(void);
 
 extern const void boot_stack;
 
+#ifdef CONFIG_X86_64
+syscall_stack_t syscall_stacks[MAX_CORES];
+#endif
+
 void set_kernel_stack(void)
 {
-	task_t* curr_task = current_task;
+	task_t* curr_task = per_core(current_task);
 
 #ifdef CONFIG_X86_32
-	task_state_segment.esp0 = (size_t) curr_task->stack + KERNEL_STACK_SIZE - 16; // => stack is 16byte aligned
+	task_state_segment[CORE_ID].esp0 = (size_t) curr_task->stack + KERNEL_STACK_SIZE - 16; // => stack is 16byte aligned
 #else
-	task_state_segment.rsp0 = (size_t) curr_task->stack + KERNEL_STACK_SIZE - 16; // => stack is 16byte aligned
+	task_state_segment[CORE_ID].rsp0 = (size_t) curr_task->stack + KERNEL_STACK_SIZE - 16; // => stack is 16byte aligned
+	syscall_stacks[CORE_ID].kernel_rsp = task_state_segment[CORE_ID].rsp0;
 #endif
 }
 
 size_t get_kernel_stack(void)
 {
-	task_t* curr_task = current_task;
+	task_t* curr_task = per_core(current_task);
 
 	return (size_t) curr_task->stack + KERNEL_STACK_SIZE - 16;
 }
@@ -101,9 +106,9 @@ void configure_gdt_entry(gdt_entry_t *dest_entry, unsigned long base, unsigned l
 void gdt_install(void)
 {
 	unsigned long gran_ds, gran_cs, limit;
-	int num = 0;
+	int i, num = 0;
 
-	memset(&task_state_segment, 0x00, sizeof(tss_t));
+	memset(task_state_segment, 0x00, MAX_CORES*sizeof(tss_t));
 
 #ifdef CONFIG_X86_32
 	gran_cs = gran_ds = GDT_FLAG_32_BIT | GDT_FLAG_4K_GRAN;
@@ -158,18 +163,26 @@ void gdt_install(void)
 	gdt_set_gate(num++, 0, limit,
 		GDT_FLAG_RING3 | GDT_FLAG_SEGMENT | GDT_FLAG_CODESEG | GDT_FLAG_PRESENT, gran_cs);
 
-	task_state_segment.rsp0 = (size_t) &boot_stack - 0x10;
-	gdt_set_gate(num++, (unsigned long) (&task_state_segment), sizeof(tss_t)-1,
-			GDT_FLAG_PRESENT | GDT_FLAG_TSS | GDT_FLAG_RING0, gran_ds);
+	/*
+	 * Create a TSS for each core. A 64bit TSS descriptor
+	 * needs two entries of the GDT.
+	 */
+	for(i=0; i<MAX_CORES; i++, num+=2) {
+		task_state_segment[i].rsp0 = (size_t) &boot_stack + (i+1) * KERNEL_STACK_SIZE - 0x10;
+		gdt_set_gate(num, (unsigned long) (task_state_segment+i), sizeof(tss_t)-1,
+				GDT_FLAG_PRESENT | GDT_FLAG_TSS | GDT_FLAG_RING0, gran_ds);
+	}
 #elif defined(CONFIG_X86_32)
-	/* set default values */
-	task_state_segment.eflags = 0x1202;
-	task_state_segment.ss0 = 0x10;			// data segment
-	task_state_segment.esp0 = (size_t) &boot_stack - 0x10;
-	task_state_segment.cs = 0x0b;
-	task_state_segment.ss = task_state_segment.ds = task_state_segment.es = task_state_segment.fs = task_state_segment.gs = 0x13;
-	gdt_set_gate(num++, (unsigned long) (&task_state_segment), sizeof(tss_t)-1,
-			GDT_FLAG_PRESENT | GDT_FLAG_TSS | GDT_FLAG_RING0, gran_ds);
+	/* create a TSS for each core and set default values */
+	for(i=0; i<MAX_CORES; i++, num++) {
+		task_state_segment[i].eflags = 0x1202;
+		task_state_segment[i].ss0 = 0x10;			// data segment
+		task_state_segment[i].esp0 = (size_t) &boot_stack + (i+1) * KERNEL_STACK_SIZE - 0x10;
+		task_state_segment[i].cs = 0x0b;
+		task_state_segment[i].ss = task_state_segment[i].ds = task_state_segment[i].es = task_state_segment[i].fs = task_state_segment[i].gs = 0x13;
+		gdt_set_gate(num, (unsigned long) (task_state_segment+i), sizeof(tss_t)-1,
+				GDT_FLAG_PRESENT | GDT_FLAG_TSS | GDT_FLAG_RING0, gran_ds);
+	}
 #endif
 
 	/* Flush out the old GDT and install the new changes! */
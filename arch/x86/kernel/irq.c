@@ -70,6 +70,8 @@ extern void irq20(void);
 extern void irq21(void);
 extern void irq22(void);
 extern void irq23(void);
+extern void wakeup(void);
+extern void tlb_ipi(void);
 extern void apic_timer(void);
 extern void apic_lint0(void);
 extern void apic_lint1(void);
@@ -194,6 +196,10 @@ static int irq_install(void)
 		IDT_FLAG_PRESENT|IDT_FLAG_RING0|IDT_FLAG_32BIT|IDT_FLAG_INTTRAP);
 
 	// add APIC interrupt handler
+	idt_set_gate(121, (size_t)wakeup, KERNEL_CODE_SELECTOR,
+		IDT_FLAG_PRESENT|IDT_FLAG_RING0|IDT_FLAG_32BIT|IDT_FLAG_INTTRAP);
+	idt_set_gate(122, (size_t)tlb_ipi, KERNEL_CODE_SELECTOR,
+		IDT_FLAG_PRESENT|IDT_FLAG_RING0|IDT_FLAG_32BIT|IDT_FLAG_INTTRAP);
 	idt_set_gate(123, (size_t)apic_timer, KERNEL_CODE_SELECTOR,
 		IDT_FLAG_PRESENT|IDT_FLAG_RING0|IDT_FLAG_32BIT|IDT_FLAG_INTTRAP);
 	idt_set_gate(124, (size_t)apic_lint0, KERNEL_CODE_SELECTOR,
@@ -273,9 +279,9 @@ size_t** irq_handler(struct state *s)
 
 leave_handler:
 	// timer interrupt?
-	if (s->int_no == 32)
+	if ((s->int_no == 32) || (s->int_no == 123))
 		return scheduler(); // switch to a new task
-	else if ((s->int_no >= 32) && (get_highest_priority() > current_task->prio))
+	else if ((s->int_no >= 32) && (get_highest_priority() > per_core(current_task)->prio))
 		return scheduler();
 
 	return NULL;
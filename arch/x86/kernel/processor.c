@@ -140,10 +140,16 @@ int cpu_detection(void) {
 
 		cpuid(0x80000001, &a, &b, &c, &cpu_info.feature3);
 		cpuid(0x80000008, &cpu_info.addr_width, &b, &c, &d);
+
+		cpuid(0, &a, &b, &c, &d);
+		if (a >= 7) {
+			c = 0;
+			cpuid(7, &a, &cpu_info.feature4, &c, &d);
+		}
 	}
 
 	if (first_time) {
-		kprintf("Paging features: %s%s%s%s%s%s%s%s\n",
+		kprintf("Paging features: %s%s%s%s%s%s%s%s%s%s\n",
 				(cpu_info.feature1 & CPU_FEATUE_PSE) ? "PSE (2/4Mb) " : "",
 				(cpu_info.feature1 & CPU_FEATURE_PAE) ? "PAE " : "",
 				(cpu_info.feature1 & CPU_FEATURE_PGE) ? "PGE " : "",
@@ -151,6 +157,8 @@ int cpu_detection(void) {
 				(cpu_info.feature1 & CPU_FEATURE_PSE36) ? "PSE36 " : "",
 				(cpu_info.feature3 & CPU_FEATURE_NX) ? "NX " : "",
 				(cpu_info.feature3 & CPU_FEATURE_1GBHP) ? "PSE (1Gb) " : "",
+				(cpu_info.feature2 & CPU_FEATURE_PCID) ? "PCID " : "",
+				(cpu_info.feature4 & CPU_FEATURE_INVPCID) ? "INVPCID " : "",
 				(cpu_info.feature3 & CPU_FEATURE_LM) ? "LM" : "");
 
 		kprintf("Physical adress-width: %u bits\n", cpu_info.addr_width & 0xff);
@@ -173,11 +181,18 @@ int cpu_detection(void) {
 		wrmsr(MSR_EFER, rdmsr(MSR_EFER) | EFER_LMA | EFER_SCE);
 		wrmsr(MSR_STAR, (0x1BULL << 48) | (0x08ULL << 32));
 		wrmsr(MSR_LSTAR, (size_t) &isrsyscall);
-		wrmsr(MSR_SYSCALL_MASK, 0); // we didn't clear RFLAGS during an interrupt
+		wrmsr(MSR_SYSCALL_MASK, EFLAGS_IF); // no interrupts, until isrsyscall switched the stack
 	} else kputs("Processor doesn't support syscalls\n");
 
 	if (has_nx())
 		wrmsr(MSR_EFER, rdmsr(MSR_EFER) | EFER_NXE);
+
+	/* Tag the TLB entries by the task id => see page_map_switch().
+	 * CR4.PCIDE may only be set, while the current PCID is zero. */
+	if (has_pcid()) {
+		write_cr3(read_cr3() & ~CR3_PCID);
+		write_cr4(read_cr4() | CR4_PCIDE);
+	}
 #endif
 
 	if (first_time && has_sse())
@@ -230,3 +245,14 @@ uint32_t get_cpu_frequency(void)
 	return detect_cpu_frequency();
 }
 
+void udelay(uint32_t usecs)
+{
+	uint64_t diff, end, start = rdtsc();
+	uint64_t deadline = (uint64_t) get_cpu_frequency() * usecs;
+
+	do {
+		PAUSE;
+		end = rdtsc();
+		diff = end > start ? end - start : start - end;
+	} while(diff < deadline);
+}
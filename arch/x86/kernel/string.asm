@@ -86,4 +86,35 @@ L3:
 %endif
    ret
 
+; size_t copy_user(void* dest, const void* src, size_t n)
+; Copies n bytes and returns the number of bytes, which aren't copied.
+; A page fault at copy_user_fault, which the page fault handler isn't
+; able to resolve, continues at copy_user_fixup (see page.c).
+global copy_user
+global copy_user_fault
+global copy_user_fixup
+copy_user:
+%ifdef CONFIG_X86_32
+   push edi
+   push esi
+
+   mov edi, [esp+12]
+   mov esi, [esp+16]
+   mov ecx, [esp+20]
+%else
+   mov rcx, rdx
+%endif
+   cld
+copy_user_fault:
+   rep movsb
+copy_user_fixup:
+%ifdef CONFIG_X86_32
+   mov eax, ecx
+   pop esi
+   pop edi
+%else
+   mov rax, rcx
+%endif
+   ret
+
 SECTION .note.GNU-stack noalloc noexec nowrite progbits
@@ -39,10 +39,10 @@
 
 size_t* get_current_stack(void)
 {
-	task_t* curr_task = current_task;
+	task_t* curr_task = per_core(current_task);
 
 	// use new page table
-	write_cr3(curr_task->page_map);
+	page_map_switch(curr_task);
 
 	return curr_task->last_stack_pointer;
 }
@@ -140,6 +140,9 @@ typedef struct {
 	char buffer[MAX_ARGS];
 } load_args_t;
 
+/// Cache for the arguments of new user tasks
+static kmem_cache_t load_args_cache = KMEM_CACHE_INIT("load_args", sizeof(load_args_t));
+
 /** @brief Internally used function to load tasks with a load_args_t structure
  * keeping all the information needed to launch.
  *
@@ -155,12 +158,12 @@ static int load_task(load_args_t* largs)
 	elf_program_header_t prog_header;
 	//elf_section_header_t sec_header;
 	///!!! kfree is missing!
-	fildes_t *file = kmalloc(sizeof(fildes_t));
+	fildes_t *file = kmem_cache_alloc(&fildes_cache);
 	file->offset = 0;
 	file->flags = 0;
 
 	//TODO: init the hole fildes_t struct!
-	task_t* curr_task = current_task;
+	task_t* curr_task = per_core(current_task);
 	int err;
 
 	if (!largs)
@@ -248,14 +251,14 @@ static int load_task(load_args_t* largs)
 			file->offset = prog_header.offset;
 			read_fs(file, (uint8_t*)prog_header.virt_addr, prog_header.file_size);
 
-			flags = VMA_CACHEABLE;
+			flags = VMA_CACHEABLE|VMA_USER;
 			if (prog_header.flags & PF_R)
 				flags |= VMA_READ;
 			if (prog_header.flags & PF_W)
 				flags |= VMA_WRITE;
 			if (prog_header.flags & PF_X)
 				flags |= VMA_EXECUTE;
-			vma_add(prog_header.virt_addr, prog_header.virt_addr+npages*PAGE_SIZE-1, flags);
+			vma_add(prog_header.virt_addr, prog_header.virt_addr+npages*PAGE_SIZE, flags);
 
 			if (!(prog_header.flags & PF_W))
 				page_set_flags(prog_header.virt_addr, npages, flags);
@@ -282,14 +285,14 @@ static int load_task(load_args_t* largs)
 			memset((void*) stack, 0x00, npages*PAGE_SIZE);
 
 			// create vma regions for the user-level stack
-			flags = VMA_CACHEABLE;
+			flags = VMA_CACHEABLE|VMA_USER;
 			if (prog_header.flags & PF_R)
 				flags |= VMA_READ;
 			if (prog_header.flags & PF_W)
 				flags |= VMA_WRITE;
 			if (prog_header.flags & PF_X)
 				flags |= VMA_EXECUTE;
-			vma_add(stack, stack+npages*PAGE_SIZE-1, flags);
+			vma_add(stack, stack+npages*PAGE_SIZE, flags);
 			break;
 		}
 	}
@@ -312,6 +315,12 @@ static int load_task(load_args_t* largs)
 		return -ENOMEM;
 	}
 
+	// the task reads the time without a system call
+	if (BUILTIN_EXPECT(vclock_map(), 0)) {
+		kprintf("load_task: unable to map the clock page\n");
+		return -ENOMEM;
+	}
+
 	// push strings on the stack
 	offset = DEFAULT_STACK_SIZE-8;
 	memset((void*) (stack+offset), 0, 4);
@@ -355,7 +364,7 @@ static int load_task(load_args_t* largs)
 	offset -= sizeof(ssize_t);
 	*((ssize_t*) (stack+offset)) = (ssize_t) largs->argc;
 
-	kfree(largs);
+	kmem_cache_free(&load_args_cache, largs);
 
 	// clear fpu state => currently not supported
 	curr_task->flags &= ~(TASK_FPU_USED|TASK_FPU_INIT);
@@ -389,7 +398,7 @@ static int user_entry(void* arg)
 
 	ret = load_task((load_args_t*) arg);
 
-	kfree(arg);
+	kmem_cache_free(&load_args_cache, arg);
 
 	return ret;
 }
@@ -404,6 +413,11 @@ static int user_entry(void* arg)
  * - -ENOMEM (-12) or -EINVAL (-22) on failure
  */
 int create_user_task(tid_t* id, const char* fname, char** argv)
+{
+	return create_user_task_on_core(id, fname, argv, get_next_core_id());
+}
+
+int create_user_task_on_core(tid_t* id, const char* fname, char** argv, uint32_t core_id)
 {
 	vfs_node_t* node;
 	int argc = 0;
@@ -428,7 +442,7 @@ int create_user_task(tid_t* id, const char* fname, char** argv)
 	if (buffer_size >= MAX_ARGS)
 		return -EINVAL;
 
-	load_args = kmalloc(sizeof(load_args_t));
+	load_args = kmem_cache_alloc(&load_args_cache);
 	if (BUILTIN_EXPECT(!load_args, 0))
 		return -ENOMEM;
 	load_args->node = node;
@@ -442,5 +456,5 @@ int create_user_task(tid_t* id, const char* fname, char** argv)
 
 
 	/* create new task */
-	return create_task(id, user_entry, load_args, NORMAL_PRIO);
+	return create_task(id, user_entry, load_args, NORMAL_PRIO, core_id);
 }
@@ -30,10 +30,14 @@
 #include <eduos/tasks.h>
 #include <eduos/time.h>
 #include <eduos/errno.h>
+#include <eduos/spinlock.h>
+#include <eduos/vma.h>
 #include <asm/irq.h>
 #include <asm/irqflags.h>
 #include <asm/vga.h>
 #include <asm/io.h>
+#include <asm/apic.h>
+#include <asm/page.h>
 
 /* 
  * This will keep track of how many ticks the system
@@ -41,20 +45,376 @@
  */
 static volatile uint64_t timer_ticks = 0;
 
+/// Does the APIC timer work in the one-shot mode?
+static volatile uint8_t oneshot = 0;
+/// TSC value at the switch to the one-shot mode
+static uint64_t tsc_base = 0;
+
+/// Clock page, which is shared with the user space. It occupies a whole page.
+static union {
+	vclock_t clock;
+	uint8_t pad[PAGE_SIZE];
+} vclock __attribute__ ((aligned (PAGE_SIZE)));
+
+/** @brief Publish a new time base on the clock page
+ *
+ * Only a single writer exists: the boot processor in the periodic mode
+ * or the switch to the one-shot mode.
+ */
+static inline void vclock_update(uint64_t ticks, uint64_t tsc, uint32_t freq)
+{
+	vclock.clock.seq++;
+	wmb();
+	vclock.clock.ticks = ticks;
+	vclock.clock.tsc = tsc;
+	vclock.clock.freq = freq;
+	wmb();
+	vclock.clock.seq++;
+}
+
+/// number of slots of a timer wheel (power of two)
+#define TIMER_WHEEL_SLOTS	256
+/// time span of a slot in microseconds
+#define TIMER_SLOT_USEC		1000
+/// slot of a deadline
+#define TIMER_SLOT(deadline)	(((deadline) / TIMER_SLOT_USEC) & (TIMER_WHEEL_SLOTS-1))
+
+/** @brief Timer wheel of a core
+ *
+ * A timer is hashed by its deadline into a slot of the wheel. Hence,
+ * adding and removing a timer is O(1). A slot contains the timers of
+ * all rounds of the wheel, which expire in the slot's time span.
+ */
+typedef struct {
+	/// Unsorted list of timers for each slot
+	ktimer_t* slots[TIMER_WHEEL_SLOTS];
+	/// Earliest deadline of the active timers or 0, if no timer is active
+	uint64_t next;
+	/// Time of the last expiration run
+	uint64_t clock;
+	/// Number of active timers
+	uint32_t count;
+	/// Timer, whose callback the core is currently calling
+	ktimer_t* volatile running;
+	/// Lock for this wheel
+	spinlock_irqsave_t lock;
+} timer_wheel_t;
+
+static timer_wheel_t timer_wheels[MAX_CORES] = { \
+		[0 ... MAX_CORES-1] = {{[0 ... TIMER_WHEEL_SLOTS-1] = NULL}, 0, 0, 0, NULL, SPINLOCK_IRQSAVE_INIT}};
+
 uint64_t get_clock_tick(void)
 {
+	if (oneshot)
+		return get_clock_usec() / TIMESLICE_USEC;
+
 	return timer_ticks;
 }
 
+uint64_t get_clock_usec(void)
+{
+	if (oneshot)
+		return timer_ticks * TIMESLICE_USEC + (rdtsc() - tsc_base) / get_cpu_frequency();
+
+	return timer_ticks * TIMESLICE_USEC;
+}
+
+void timer_oneshot_init(void)
+{
+	uint8_t flags = irq_nested_disable();
+
+	// from now on, the tick counter is derived from the TSC
+	tsc_base = rdtsc();
+	wmb();
+	oneshot = 1;
+
+	// timer_ticks is frozen, the user space extrapolates from tsc_base
+	vclock_update(timer_ticks, tsc_base, get_cpu_frequency());
+
+	timer_reprogram();
+	irq_nested_enable(flags);
+}
+
+int vclock_map(void)
+{
+	size_t bits = PG_USER;
+	int ret;
+
+#ifdef CONFIG_X86_64
+	if (has_nx())
+		bits |= PG_XD;
+#endif
+
+	ret = vma_add(VCLOCK_ADDR, VCLOCK_ADDR + PAGE_SIZE, VMA_USER|VMA_READ|VMA_CACHEABLE);
+	if (BUILTIN_EXPECT(ret, 0))
+		return ret;
+
+	// read-only, the task isn't able to modify the kernel's page
+	return page_map(VCLOCK_ADDR, virt_to_phys((size_t) &vclock), 1, bits);
+}
+
+void vclock_unmap(void)
+{
+	page_unmap(VCLOCK_ADDR, 1);
+}
+
+void timer_setup(ktimer_t* timer, timer_func_t func, void* arg)
+{
+	timer->deadline = 0;
+	timer->func = func;
+	timer->arg = arg;
+	timer->core = MAX_CORES;
+	timer->next = timer->prev = NULL;
+}
+
+/** @brief Add a timer to a slot of a wheel */
+static inline void wheel_insert(timer_wheel_t* wheel, ktimer_t* timer)
+{
+	ktimer_t** slot = wheel->slots + TIMER_SLOT(timer->deadline);
+
+	timer->prev = NULL;
+	timer->next = *slot;
+	if (*slot)
+		(*slot)->prev = timer;
+	*slot = timer;
+	wheel->count++;
+}
+
+/** @brief Remove a timer from its slot */
+static inline void wheel_remove(timer_wheel_t* wheel, ktimer_t* timer)
+{
+	if (timer->prev)
+		timer->prev->next = timer->next;
+	else
+		wheel->slots[TIMER_SLOT(timer->deadline)] = timer->next;
+
+	if (timer->next)
+		timer->next->prev = timer->prev;
+
+	timer->core = MAX_CORES;
+	timer->next = timer->prev = NULL;
+	wheel->count--;
+}
+
+/** @brief Determine the earliest deadline of a wheel
+ *
+ * Starting at the current slot, the first slot with a timer
+ * of the current round contains the earliest deadline.
+ */
+static uint64_t wheel_next(timer_wheel_t* wheel)
+{
+	uint64_t start, end, next = 0;
+	ktimer_t* timer;
+	uint32_t i;
+
+	if (!wheel->count)
+		return 0;
+
+	start = (wheel->clock / TIMER_SLOT_USEC) * TIMER_SLOT_USEC;
+	for(i=0; i<TIMER_WHEEL_SLOTS; i++) {
+		end = start + (i+1) * TIMER_SLOT_USEC;
+		for(timer=wheel->slots[TIMER_SLOT(end - TIMER_SLOT_USEC)]; timer; timer=timer->next) {
+			if ((timer->deadline < end) && (!next || (timer->deadline < next)))
+				next = timer->deadline;
+		}
+
+		if (next)
+			return next;
+	}
+
+	// all timers expire after the current round
+	for(i=0; i<TIMER_WHEEL_SLOTS; i++) {
+		for(timer=wheel->slots[i]; timer; timer=timer->next) {
+			if (!next || (timer->deadline < next))
+				next = timer->deadline;
+		}
+	}
+
+	return next;
+}
+
+int timer_add(ktimer_t* timer, uint64_t deadline)
+{
+	timer_wheel_t* wheel;
+	uint8_t flags;
+	int first = 0;
+
+	if (BUILTIN_EXPECT(timer->core < MAX_CORES, 0))
+		return -EINVAL;
+
+	// the timer belongs to the core, which is interrupted by the timer
+	flags = irq_nested_disable();
+	wheel = timer_wheels + CORE_ID;
+
+	spinlock_irqsave_lock(&wheel->lock);
+
+	// slots before the last expiration run are already handled
+	if (deadline < wheel->clock)
+		deadline = wheel->clock;
+
+	timer->deadline = deadline;
+	timer->core = CORE_ID;
+	wheel_insert(wheel, timer);
+
+	if (!wheel->next || (deadline < wheel->next)) {
+		wheel->next = deadline;
+		first = 1;
+	}
+
+	spinlock_irqsave_unlock(&wheel->lock);
+
+	// the new timer expires before all other timers
+	if (first)
+		timer_reprogram();
+
+	irq_nested_enable(flags);
+
+	return 0;
+}
+
+int timer_del(ktimer_t* timer)
+{
+	timer_wheel_t* wheel;
+	uint32_t core_id, i;
+	uint8_t flags;
+	int ret = -EINVAL;
+
+	// a callback may add the timer to another wheel in the meantime => retry
+	while ((ret < 0) && ((core_id = ((volatile ktimer_t*) timer)->core) < MAX_CORES)) {
+		wheel = timer_wheels + core_id;
+		spinlock_irqsave_lock(&wheel->lock);
+
+		// is the timer still part of the wheel?
+		if (timer->core == core_id) {
+			wheel_remove(wheel, timer);
+			// an outdated deadline causes only a spurious interrupt
+			if (!wheel->count)
+				wheel->next = 0;
+			ret = 0;
+		}
+
+		spinlock_irqsave_unlock(&wheel->lock);
+	}
+
+	/*
+	 * Wait for callbacks, which other cores are still calling. The
+	 * callback of this core is the caller itself, because callbacks
+	 * run with disabled interrupts.
+	 */
+	flags = irq_nested_disable();
+	for(i=0; i<MAX_CORES; i++) {
+		while ((i != CORE_ID) && (timer_wheels[i].running == timer)) {
+			tlb_shootdown_poll();
+			PAUSE;
+		}
+	}
+	irq_nested_enable(flags);
+
+	return ret;
+}
+
+/** @brief Call the callbacks of all expired timers of the current core
+ *
+ * Walks through all slots, which have passed since the last run.
+ */
+static void timer_expire(void)
+{
+	timer_wheel_t* wheel = timer_wheels + CORE_ID;
+	uint64_t now = get_clock_usec();
+	uint64_t slot, last;
+	ktimer_t* timer;
+
+	spinlock_irqsave_lock(&wheel->lock);
+
+	slot = wheel->clock / TIMER_SLOT_USEC;
+	last = now / TIMER_SLOT_USEC;
+	if (last - slot >= TIMER_WHEEL_SLOTS)
+		slot = last - TIMER_WHEEL_SLOTS + 1;
+
+	for(; wheel->count && (slot <= last); slot++) {
+		timer = wheel->slots[slot & (TIMER_WHEEL_SLOTS-1)];
+		while (timer) {
+			if (timer->deadline > now) {
+				timer = timer->next;
+				continue;
+			}
+
+			wheel_remove(wheel, timer);
+			wheel->running = timer;
+
+			// the callback is allowed to add the timer again
+			spinlock_irqsave_unlock(&wheel->lock);
+			timer->func(timer->arg);
+			spinlock_irqsave_lock(&wheel->lock);
+
+			wheel->running = NULL;
+
+			// the slot may be changed => restart at its head
+			timer = wheel->slots[slot & (TIMER_WHEEL_SLOTS-1)];
+		}
+	}
+
+	wheel->clock = now;
+	wheel->next = wheel_next(wheel);
+
+	spinlock_irqsave_unlock(&wheel->lock);
+}
+
+void timer_reprogram(void)
+{
+	timer_wheel_t* wheel;
+	uint64_t now, next;
+	uint8_t flags;
+
+	if (!oneshot)
+		return;
+
+	flags = irq_nested_disable();
+	wheel = timer_wheels + CORE_ID;
+
+	spinlock_irqsave_lock(&wheel->lock);
+	next = wheel->next;
+	spinlock_irqsave_unlock(&wheel->lock);
+
+	now = get_clock_usec();
+
+	// end of the current time slice
+	if ((per_core(current_task)->status != TASK_IDLE) && (!next || (next > now + TIMESLICE_USEC)))
+		next = now + TIMESLICE_USEC;
+
+	if (!next)
+		apic_timer_deadline(0);	// nothing is due => sleep until the next interrupt
+	else
+		apic_timer_deadline(next > now ? next - now : 1);
+
+	irq_nested_enable(flags);
+}
+
 /* 
- * Handles the timer. In this case, it's very simple: We
+ * Handles the timer. In the periodic mode, it's very simple: We
  * increment the 'timer_ticks' variable every time the
- * timer fires. 
+ * timer fires. In both modes, expired timers are handled.
+ * In the one-shot mode, the next interrupt is programmed.
  */
 static void timer_handler(struct state *s)
 {
-	/* Increment our 'tick counter' */
-	timer_ticks++;
+	if (oneshot) {
+		timer_expire();
+		timer_reprogram();
+		return;
+	}
+
+	/*
+	 * Each core owns an APIC timer, but only the
+	 * boot processor increments our 'tick counter'
+	 */
+	if (CORE_ID == 0) {
+		timer_ticks++;
+		// calibrating the TSC waits for ticks => keep the published frequency
+		vclock_update(timer_ticks, rdtsc(), vclock.clock.freq);
+	}
+
+	timer_expire();
 
 	/*
 	 * Every TIMER_FREQ clocks (approximately 1 second), we will
@@ -65,6 +425,31 @@ static void timer_handler(struct state *s)
 	//}
 }
 
+int timer_wait(unsigned int ticks)
+{
+	uint64_t deadline = get_clock_usec() + (uint64_t) ticks * TIMESLICE_USEC;
+	task_t* curr_task = per_core(current_task);
+
+	if (curr_task->status == TASK_IDLE) {
+		/*
+		 * The idle task isn't able to block. Its timer interrupts
+		 * the HALT instruction after the deadline.
+		 */
+		while (get_clock_usec() < deadline) {
+			timer_del(&curr_task->timer);
+			timer_add(&curr_task->timer, deadline);
+			HALT;
+		}
+	} else {
+		while (get_clock_usec() < deadline) {
+			block_current_task_timeout(deadline);
+			reschedule();
+		}
+	}
+
+	return 0;
+}
+
 #define LATCH(f)	((CLOCK_TICK_RATE + f/2) / f)
 #define WAIT_SOME_TIME() do { uint64_t start = rdtsc(); \
 			      while(rdtsc() - start < 1000000) ; \
@@ -106,5 +491,7 @@ int timer_init(void)
 
 	outportb(0x40, LATCH(TIMER_FREQ) >> 8);     /* high byte */
 
+	vclock.clock.hz = TIMER_FREQ;
+
 	return 0;
 }
@@ -101,7 +101,7 @@
 static uint8_t	mmio = 0;
 static size_t	iobase = 0;
 static tid_t	id;
-static mailbox_uint8_t input_queue;
+static mailbox_spsc_uint8_t input_queue;
 
 static inline unsigned char read_from_uart(uint32_t off)
 {
@@ -164,7 +164,8 @@ static void uart_handler(struct state *s)
 		if (c & UART_IIR_RDI) {
 			c = uart_getchar();
 
-			mailbox_uint8_post(&input_queue, c);
+			// the handler doesn't block => drop the character, if the queue is full
+			mailbox_spsc_uint8_post(&input_queue, c);
 
 			goto out;
 		}
@@ -191,12 +192,14 @@ out:
 /* thread entry point => handles all incoming messages */
 static int uart_thread(void* arg)
 {
-	unsigned char c = 0;
+	uint8_t buffer[MAILBOX_SIZE];
+	int i, n;
 
 	while(1) {
-		mailbox_uint8_fetch(&input_queue, &c);
+		n = mailbox_spsc_uint8_fetch_n(&input_queue, buffer, MAILBOX_SIZE);
 
-		kputchar(c);
+		for(i=0; i<n; i++)
+			kputchar(buffer[i]);
 	}
 
 	return 0;
@@ -239,7 +242,7 @@ static int uart_config(uint8_t early)
 	write_to_uart(UART_LCR, lcr & (~UART_LCR_DLAB));
 
 	if (!early) {
-		mailbox_uint8_init(&input_queue);
+		mailbox_spsc_uint8_init(&input_queue);
 
 		/* enable interrupt */
 		write_to_uart(UART_IER, UART_IER_RDI | UART_IER_RLSI | UART_IER_THRI);
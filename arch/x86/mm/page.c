@@ -39,8 +39,12 @@
 #include <eduos/errno.h>
 #include <eduos/string.h>
 #include <eduos/spinlock.h>
+#include <eduos/mutex.h>
+#include <eduos/rwlock.h>
+#include <eduos/time.h>
 
 #include <asm/irq.h>
+#include <asm/apic.h>
 #include <asm/page.h>
 #include <asm/multiboot.h>
 
@@ -49,11 +53,34 @@
 extern const void kernel_start;
 //extern const void kernel_end;
 
-/// This page is reserved for copying
-#define PAGE_TMP		(PAGE_FLOOR((size_t) &kernel_start) - PAGE_SIZE)
+/* Fault-tolerant user copy, see string.asm */
+extern const void copy_user_fault;
+extern const void copy_user_fixup;
+
+/*
+ * These pages are reserved for copying. Each core uses its own page
+ * below the pages of the IOAPIC and the local APIC.
+ */
+#define PAGE_TMP		(PAGE_FLOOR((size_t) &kernel_start) - (3+CORE_ID)*PAGE_SIZE)
+#define PAGE_ZERO		(PAGE_FLOOR((size_t) &kernel_start) - (3+MAX_CORES+CORE_ID)*PAGE_SIZE)
 
 /** Lock for kernel space page tables */
-static spinlock_t kslock = SPINLOCK_INIT;
+static mutex_t kslock = MUTEX_INIT;
+
+/// Smallest fault-around window in pages (power of two)
+#define FAULT_AROUND_MIN	4
+/// Largest fault-around window in pages (power of two)
+#define FAULT_AROUND_MAX	64
+
+/** Physical address within a page table entry */
+#ifdef CONFIG_X86_64
+#define PAGE_ENTRY_ADDR(entry)	((entry) & PAGE_MASK & ~PG_XD)
+#else
+#define PAGE_ENTRY_ADDR(entry)	((entry) & PAGE_MASK)
+#endif
+
+/** Number of entries at level lvl, which cover only the kernel space */
+#define KERNEL_ENTRIES(lvl)	((long) (KERNEL_SPACE >> ((lvl) * PAGE_MAP_BITS + PAGE_BITS)))
 
 /** This PGD table is initialized in entry.asm */
 extern size_t* boot_map;
@@ -88,14 +115,230 @@ static size_t * const other[PAGE_LEVELS] = {
 };
 #endif
 
+/** Number of pages, which are covered by an entry at level lvl */
+#define PAGE_LEVEL_PAGES(lvl)	(1UL << ((lvl) * PAGE_MAP_BITS))
+
+/** @brief Highest level, at which page_map() installs huge pages
+ *
+ * On 32 bit, the kernel page tables are linked into each task, but the
+ * page directories are copied. Huge pages would live in the page
+ * directories and diverge between the tasks. Therefore, they are
+ * only used on 64 bit (2 MiB, and 1 GiB if supported).
+ */
+static inline int page_huge_level(void)
+{
+#ifdef CONFIG_X86_64
+	return has_1gbhp() ? 2 : 1;
+#else
+	return 0;
+#endif
+}
+
 size_t virt_to_phys(size_t addr)
 {
-	size_t vpn   = addr >> PAGE_BITS;	// virtual page number
-	size_t entry = self[0][vpn];		// page table entry
-	size_t off   = addr  & ~PAGE_MASK;	// offset within page
-	size_t phy   = entry &  PAGE_MASK;	// physical page frame number
+	size_t vpn = addr >> PAGE_BITS;	// virtual page number
+	size_t entry, size;
+	int lvl;
+
+	for (lvl=PAGE_LEVELS-1; lvl>=0; lvl--) {
+		entry = self[lvl][vpn >> (lvl * PAGE_MAP_BITS)];
+		if (!(entry & PG_PRESENT))
+			return 0;
+
+		if (!lvl || (entry & PG_PSE)) {
+			size = PAGE_LEVEL_PAGES(lvl) << PAGE_BITS;
+			return (PAGE_ENTRY_ADDR(entry) & ~(size - 1)) | (addr & (size - 1));
+		}
+	}
+
+	return 0;
+}
+
+/** @brief Flush the entries of a batch or all entries, if batch is NULL */
+static void tlb_flush_batch_local(const tlb_batch_t* batch)
+{
+	uint32_t i;
+
+	if (batch && (batch->count <= TLB_BATCH_SIZE)) {
+		for (i=0; i<batch->count; i++)
+			tlb_flush_one_page(batch->addr[i]);
+	} else if (!batch || batch->kernel)
+		flush_tlb_global();
+	else
+		flush_tlb();
+}
+
+#if MAX_CORES > 1
+/*
+ * Kernel mappings are shared by all cores. After changing them, the
+ * stale entries are shot down by an IPI, before the page frames are
+ * reused. User mappings don't need an IPI: a task runs on one core at
+ * a time, and tlb_cores forces a flush on the other cores (see
+ * page_map_switch()).
+ */
+
+/// serializes the senders of shootdowns (a waiting sender has to process shootdowns)
+static atomic_int32_t shootdown_lock = ATOMIC_INIT(0);
+/// pages of the current shootdown, count > TLB_BATCH_SIZE => all pages
+static tlb_batch_t shootdown_batch = TLB_BATCH_INIT;
+/// cores, which haven't yet processed the current shootdown
+static volatile uint8_t shootdown_pending[MAX_CORES] = {[0 ... MAX_CORES-1] = 0};
+
+/** @brief Process a pending shootdown of this core
+ *
+ * Called by the IPI and by cores, which wait for a shootdown. Therefore,
+ * two cores, which send shootdowns at the same time, don't deadlock.
+ */
+static void tlb_shootdown_handler(struct state* s)
+{
+	uint32_t core_id = CORE_ID;
+
+	if (!shootdown_pending[core_id])
+		return;
+
+	tlb_flush_batch_local(&shootdown_batch);
+	mb();
+	shootdown_pending[core_id] = 0;
+}
+
+void tlb_shootdown_poll(void)
+{
+	tlb_shootdown_handler(NULL);
+}
+
+/** @brief Is the page a temporary mapping of a single core? */
+static inline int page_core_local(size_t viraddr)
+{
+	size_t end = PAGE_FLOOR((size_t) &kernel_start) - 2*PAGE_SIZE;
+
+	return (viraddr < end) && (viraddr >= end - 2*MAX_CORES*PAGE_SIZE);
+}
+
+/** @brief Flush kernel mappings on all other cores
+ *
+ * @param batch The changed pages or NULL to flush everything
+ */
+static void tlb_shootdown(const tlb_batch_t* batch)
+{
+	uint32_t i, core_id, count = 0;
+	uint8_t flags;
+
+	if (!apic_is_enabled())
+		return;
+
+	if (batch && (batch->count <= TLB_BATCH_SIZE)) {
+		// PAGE_TMP and PAGE_ZERO are never used by another core
+		for (i=0; (i<batch->count) && page_core_local(batch->addr[i]); i++)
+			;
+		if (i == batch->count)
+			return;
+	}
+
+	flags = irq_nested_disable();
+	core_id = CORE_ID;
+
+	while (atomic_int32_test_and_set(&shootdown_lock, 1)) {
+		tlb_shootdown_handler(NULL);
+		PAUSE;
+	}
+
+	if (batch)
+		memcpy(&shootdown_batch, batch, sizeof(tlb_batch_t));
+	else
+		shootdown_batch.count = TLB_BATCH_SIZE+1;
+	shootdown_batch.kernel = 1;
+
+	for (i=0; i<MAX_CORES; i++) {
+		if ((i != core_id) && apic_core_online(i)) {
+			shootdown_pending[i] = 1;
+			count++;
+		}
+	}
+	mb();
+
+	for (i=0; count && (i<MAX_CORES); i++) {
+		if (shootdown_pending[i])
+			apic_send_ipi(i, 122);
+	}
+
+	for (i=0; i<MAX_CORES; i++) {
+		while (shootdown_pending[i]) {
+			tlb_shootdown_handler(NULL);
+			PAUSE;
+		}
+	}
+
+	atomic_int32_set(&shootdown_lock, 0);
+	irq_nested_enable(flags);
+}
+#endif
+
+void tlb_batch_flush(tlb_batch_t* batch)
+{
+	tlb_flush_batch_local(batch);
+
+#if MAX_CORES > 1
+	if (batch->kernel)
+		tlb_shootdown(batch);
+#endif
+
+	/* Only this core is up to date => other cores have
+	 * to flush the task's PCID, before they use it again. */
+	if (batch->user)
+		per_core(current_task)->tlb_cores = 1 << CORE_ID;
 
-	return phy | off;
+	batch->count = 0;
+	batch->kernel = batch->user = 0;
+}
+
+void page_map_switch(task_t* task)
+{
+#ifdef CONFIG_X86_64
+	if (has_pcid()) {
+		size_t cr3 = task->page_map | (task->id & CR3_PCID);
+
+		/* Keep the entries, if the TLB of this core is still up to date.
+		 * Otherwise, the old entries of the PCID are flushed. */
+		if (task->tlb_cores & (1 << CORE_ID))
+			cr3 |= CR3_NOFLUSH;
+		else
+			task->tlb_cores |= 1 << CORE_ID;
+
+		write_cr3(cr3);
+		return;
+	}
+#endif
+
+	write_cr3(task->page_map);
+}
+
+/** @brief Map a page frame to a temporary page of this core
+ *
+ * PAGE_TMP and PAGE_ZERO are never used by another core and their
+ * tables exist since page_init(). Hence, neither kslock nor a
+ * shootdown is required.
+ */
+static inline void page_map_local(size_t viraddr, size_t phyaddr)
+{
+	self[0][viraddr >> PAGE_BITS] = phyaddr | PG_PRESENT | PG_RW | PG_GLOBAL;
+	tlb_flush_one_page(viraddr);
+}
+
+void page_zero(size_t phyaddr)
+{
+	size_t* dest = (size_t*) PAGE_ZERO;
+	size_t i;
+
+	page_map_local((size_t) dest, phyaddr);
+
+	if (!has_sse2()) {
+		memset(dest, 0x00, PAGE_SIZE);
+		return;
+	}
+
+	for (i=0; i<PAGE_SIZE/sizeof(size_t); i++)
+		asm volatile ("movnti %1, %0" : "=m"(dest[i]) : "r"((size_t) 0));
+	asm volatile ("sfence" ::: "memory");
 }
 
 //TODO: code is missing
@@ -104,68 +347,185 @@ int page_set_flags(size_t viraddr, uint32_t npages, int flags)
 	return -EINVAL;
 }
 
-int page_map(size_t viraddr, size_t phyaddr, size_t npages, size_t bits)
+/** @brief Replace the huge page at self[lvl][idx] by a table of smaller pages */
+static int page_split(int lvl, size_t idx)
 {
-	int lvl, ret = -ENOMEM;
-	long vpn = viraddr >> PAGE_BITS;
-	long first[PAGE_LEVELS], last[PAGE_LEVELS];
+	size_t entry = self[lvl][idx];
+	size_t phyaddr, size, i;
+	size_t* table = &self[lvl-1][idx << PAGE_MAP_BITS];
 
-	/* Calculate index boundaries for page map traversal */
-	for (lvl=0; lvl<PAGE_LEVELS; lvl++) {
-		first[lvl] = (vpn         ) >> (lvl * PAGE_MAP_BITS);
-		last[lvl]  = (vpn+npages-1) >> (lvl * PAGE_MAP_BITS);
-	}
+	phyaddr = get_page();
+	if (BUILTIN_EXPECT(!phyaddr, 0))
+		return -ENOMEM;
 
-	/** @todo: might not be sufficient! */
-	if (bits & PG_USER)
-		spinlock_irqsave_lock(&current_task->page_lock);
+#ifdef CONFIG_X86_32
+	self[lvl][idx] = phyaddr | (entry & ~PAGE_MASK & ~PG_PSE) | PG_USER | PG_RW;
+#elif defined(CONFIG_X86_64)
+	self[lvl][idx] = (phyaddr | (entry & ~PAGE_MASK & ~PG_PSE) | PG_USER | PG_RW) & ~PG_XD;
+#endif
+	/* The self-reference mapped the huge page itself until now.
+	 * With PCIDs, other tasks may still cache this translation. */
+#ifdef CONFIG_X86_64
+	if (has_pcid())
+		flush_tlb_global();
 	else
-		spinlock_lock(&kslock);
+#endif
+		tlb_flush_one_page((size_t) table);
+
+	/* the new entries map the same page frames */
+	size = PAGE_LEVEL_PAGES(lvl-1) << PAGE_BITS;
+	entry = (entry & ~PAGE_ENTRY_ADDR(entry)) | (PAGE_ENTRY_ADDR(entry) & ~((size << PAGE_MAP_BITS) - 1));
+	if (lvl == 1)
+		entry &= ~PG_PSE;
+	for (i=0; i<PAGE_MAP_ENTRIES; i++)
+		table[i] = entry + i*size;
+
+	tlb_flush_one_page((idx << PAGE_MAP_BITS) * size);
+#if MAX_CORES > 1
+	// other cores may cache the huge page and its self-reference
+	tlb_shootdown(NULL);
+#endif
 
-	/* Start iterating through the entries
-	 * beginning at the root table (PGD or PML4) */
-	for (lvl=PAGE_LEVELS-1; lvl>=0; lvl--) {
-		for (vpn=first[lvl]; vpn<=last[lvl]; vpn++) {
-			if (lvl) { /* PML4, PDPT, PGD */
-				if (!(self[lvl][vpn] & PG_PRESENT)) {
-					/* There's no table available which covers the region.
-					 * Therefore we need to create a new empty table. */
-					size_t phyaddr = get_pages(1);
-					if (BUILTIN_EXPECT(!phyaddr, 0))
-						goto out;
-					
-					if (bits & PG_USER)
-						atomic_int32_inc(&current_task->user_usage);
+	return 0;
+}
+
+/** @brief Make sure that tables down to level lvl exist for the page vpn */
+static int page_walk(size_t vpn, int lvl, size_t bits)
+{
+	size_t idx;
+	int l;
+
+	for (l=PAGE_LEVELS-1; l>lvl; l--) {
+		idx = vpn >> (l * PAGE_MAP_BITS);
+
+		if (!(self[l][idx] & PG_PRESENT)) {
+			/* There's no table available which covers the region.
+			 * Therefore we need to create a new empty table. */
+			size_t phyaddr = get_zeroed_page();
+			int zeroed = !!phyaddr;
+
+			if (!zeroed)
+				phyaddr = get_page();
+			if (BUILTIN_EXPECT(!phyaddr, 0))
+				return -ENOMEM;
 
-					/* Reference the new table within its parent */
+			if (bits & PG_USER)
+				atomic_int32_inc(&per_core(current_task)->user_usage);
+
+			/* Reference the new table within its parent */
 #ifdef CONFIG_X86_32
-					self[lvl][vpn] = phyaddr | bits | PG_PRESENT | PG_USER | PG_RW;
+			self[l][idx] = phyaddr | bits | PG_PRESENT | PG_USER | PG_RW;
 #elif defined(CONFIG_X86_64)
-					self[lvl][vpn] = (phyaddr | bits | PG_PRESENT | PG_USER | PG_RW) & ~PG_XD;
+			self[l][idx] = (phyaddr | bits | PG_PRESENT | PG_USER | PG_RW) & ~PG_XD;
 #endif
 
-					/* Fill new table with zeros */
-					memset(&self[lvl-1][vpn<<PAGE_MAP_BITS], 0, PAGE_SIZE);
-				}
-			}
-			else { /* PGT */
-				if (self[lvl][vpn] & PG_PRESENT)
-					/* There's already a page mapped at this address.
-					 * We have to flush a single TLB entry. */
-					tlb_flush_one_page(vpn << PAGE_BITS);
-
-				self[lvl][vpn] = phyaddr | bits | PG_PRESENT;
-				phyaddr += PAGE_SIZE;
-			}
+			/* Fill new table with zeros */
+			if (!zeroed)
+				memset(&self[l-1][idx<<PAGE_MAP_BITS], 0, PAGE_SIZE);
+		}
+		else if (self[l][idx] & PG_PSE) {
+			/* A huge page covers the region => split it */
+			if (BUILTIN_EXPECT(page_split(l, idx), 0))
+				return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+int page_map(size_t viraddr, size_t phyaddr, size_t npages, size_t bits)
+{
+	int lvl, ret = -ENOMEM;
+	size_t vpn = viraddr >> PAGE_BITS;
+	size_t end = vpn + npages;
+	size_t idx, pages;
+	int huge = (bits & PG_HUGE) && !(bits & PG_USER) ? page_huge_level() : 0;
+	tlb_batch_t batch = TLB_BATCH_INIT;
+
+	bits &= ~PG_HUGE;
+
+	/** @todo: might not be sufficient! */
+	if (bits & PG_USER)
+		spinlock_irqsave_lock(&per_core(current_task)->page_lock);
+	else
+		mutex_lock(&kslock);
+
+	while (vpn < end) {
+		/* Use the largest page, which is aligned and covered by the region */
+		for (lvl=huge; lvl>0; lvl--) {
+			pages = PAGE_LEVEL_PAGES(lvl);
+			if ((vpn & (pages-1)) || (vpn + pages > end) || ((phyaddr >> PAGE_BITS) & (pages-1)))
+				continue;
+
+			if (BUILTIN_EXPECT(page_walk(vpn, lvl, bits), 0))
+				goto out;
+
+			/* Don't replace an existing table by a huge page */
+			idx = vpn >> (lvl * PAGE_MAP_BITS);
+			if (!(self[lvl][idx] & PG_PRESENT) || (self[lvl][idx] & PG_PSE))
+				break;
 		}
+
+		if (!lvl && BUILTIN_EXPECT(page_walk(vpn, 0, bits), 0))
+			goto out;
+
+		idx = vpn >> (lvl * PAGE_MAP_BITS);
+		if (self[lvl][idx] & PG_PRESENT)
+			/* There's already a page mapped at this address.
+			 * We have to flush its TLB entry. */
+			tlb_batch_add(&batch, vpn << PAGE_BITS);
+
+		self[lvl][idx] = phyaddr | bits | PG_PRESENT | (lvl ? PG_PSE : 0);
+
+		pages = PAGE_LEVEL_PAGES(lvl);
+		vpn += pages;
+		phyaddr += pages << PAGE_BITS;
 	}
 
 	ret = 0;
 out:
+	tlb_batch_flush(&batch);
+
 	if (bits & PG_USER)
-		spinlock_irqsave_unlock(&current_task->page_lock);
+		spinlock_irqsave_unlock(&per_core(current_task)->page_lock);
 	else
-		spinlock_unlock(&kslock);
+		mutex_unlock(&kslock);
+
+	return ret;
+}
+
+int page_map_frames(size_t viraddr, const size_t* frames, size_t npages, size_t bits)
+{
+	size_t vpn = viraddr >> PAGE_BITS;
+	size_t i;
+	int ret = -ENOMEM;
+	tlb_batch_t batch = TLB_BATCH_INIT;
+
+	bits &= ~PG_HUGE;
+
+	if (bits & PG_USER)
+		spinlock_irqsave_lock(&per_core(current_task)->page_lock);
+	else
+		mutex_lock(&kslock);
+
+	for (i=0; i<npages; i++, vpn++) {
+		if (BUILTIN_EXPECT(page_walk(vpn, 0, bits), 0))
+			goto out;
+
+		if (self[0][vpn] & PG_PRESENT)
+			tlb_batch_add(&batch, vpn << PAGE_BITS);
+
+		self[0][vpn] = frames[i] | bits | PG_PRESENT;
+	}
+
+	ret = 0;
+out:
+	tlb_batch_flush(&batch);
+
+	if (bits & PG_USER)
+		spinlock_irqsave_unlock(&per_core(current_task)->page_lock);
+	else
+		mutex_unlock(&kslock);
 
 	return ret;
 }
@@ -173,22 +533,57 @@ out:
 /** Tables are freed by page_map_drop() */
 int page_unmap(size_t viraddr, size_t npages)
 {
+	size_t vpn = viraddr >> PAGE_BITS;
+	size_t end = vpn + npages;
+	size_t idx, pages, entry;
+	int lvl, ret = 0;
+	tlb_batch_t batch = TLB_BATCH_INIT;
+
 	/* We aquire both locks for kernel and task tables
-	 * as we dont know to which the region belongs. */
-	spinlock_irqsave_lock(&current_task->page_lock);
-	spinlock_lock(&kslock);
+	 * as we dont know to which the region belongs.
+	 * kslock is taken first, so that we don't wait for it with
+	 * disabled interrupts (and miss a TLB shootdown). */
+	mutex_lock(&kslock);
+	spinlock_irqsave_lock(&per_core(current_task)->page_lock);
+
+	/* Only the leaf entries are removed. Tables remain allocated.
+	 * Huge pages, which are partially covered, are split. */
+	while (vpn < end) {
+		for (lvl=PAGE_LEVELS-1; lvl>=0; lvl--) {
+			idx = vpn >> (lvl * PAGE_MAP_BITS);
+			entry = self[lvl][idx];
+			pages = PAGE_LEVEL_PAGES(lvl);
+
+			if (!(entry & PG_PRESENT)) {
+				/* Nothing mapped => skip the whole entry */
+				vpn = (vpn & ~(pages-1)) + pages;
+				break;
+			}
 
-	/* Start iterating through the entries.
-	 * Only the PGT entries are removed. Tables remain allocated. */
-	size_t vpn, start = viraddr>>PAGE_BITS;
-	for (vpn=start; vpn<start+npages; vpn++)
-		self[0][vpn] = 0;
+			if (!lvl || (entry & PG_PSE)) {
+				if (lvl && ((vpn & (pages-1)) || (vpn + pages > end))) {
+					if (BUILTIN_EXPECT(page_split(lvl, idx), 0)) {
+						ret = -ENOMEM;
+						goto out;
+					}
+					break; /* retry with the new table */
+				}
 
-	spinlock_irqsave_unlock(&current_task->page_lock);
-	spinlock_unlock(&kslock);
+				self[lvl][idx] = 0;
+				tlb_batch_add(&batch, vpn << PAGE_BITS);
+				vpn += pages;
+				break;
+			}
+		}
+	}
 
-	/* This can't fail because we don't make checks here */
-	return 0;
+out:
+	tlb_batch_flush(&batch);
+
+	spinlock_irqsave_unlock(&per_core(current_task)->page_lock);
+	mutex_unlock(&kslock);
+
+	return ret;
 }
 
 int page_map_drop(void)
@@ -196,22 +591,26 @@ int page_map_drop(void)
 	void traverse(int lvl, long vpn) {
 		long stop;
 		for (stop=vpn+PAGE_MAP_ENTRIES; vpn<stop; vpn++) {
+			/* Kernel tables are shared between all tasks */
+			if (lvl && (vpn < KERNEL_ENTRIES(lvl)))
+				continue;
+
 			if ((self[lvl][vpn] & PG_PRESENT) && (self[lvl][vpn] & PG_USER)) {
 				/* Post-order traversal */
 				if (lvl)
 					traverse(lvl-1, vpn<<PAGE_MAP_BITS);
 
-				put_pages(self[lvl][vpn] & PAGE_MASK, 1);
-				atomic_int32_dec(&current_task->user_usage);
+				put_page_cold(self[lvl][vpn] & PAGE_MASK);
+				atomic_int32_dec(&per_core(current_task)->user_usage);
 			}
 		}
 	}
 
-	spinlock_irqsave_lock(&current_task->page_lock);
+	spinlock_irqsave_lock(&per_core(current_task)->page_lock);
 
 	traverse(PAGE_LEVELS-1, 0);
 
-	spinlock_irqsave_unlock(&current_task->page_lock);
+	spinlock_irqsave_unlock(&per_core(current_task)->page_lock);
 
 	/* This can't fail because we don't make checks here */
 	return 0;
@@ -219,24 +618,45 @@ int page_map_drop(void)
 
 int page_map_copy(task_t *dest)
 {
+	tlb_batch_t batch = TLB_BATCH_INIT;
+
 	int traverse(int lvl, long vpn) {
 		long stop;
+
+		/* The parent's translation of this table might be stale */
+		tlb_batch_add(&batch, (size_t) &other[lvl][vpn]);
+
 		for (stop=vpn+PAGE_MAP_ENTRIES; vpn<stop; vpn++) {
 			if (self[lvl][vpn] & PG_PRESENT) {
-				if (self[lvl][vpn] & PG_USER) {
-					size_t phyaddr = get_pages(1);
+				if (lvl && (vpn < KERNEL_ENTRIES(lvl)))
+					/* Link kernel tables instead of copying them.
+					 * Otherwise later kernel mappings (e.g. stacks)
+					 * would be invisible for the other tasks. */
+					other[lvl][vpn] = self[lvl][vpn];
+				else if (!lvl && (self[lvl][vpn] & PG_USER)) {
+					/* Share the page frame. The first write access of
+					 * either task copies it => page_cow_fault() */
+					if (self[lvl][vpn] & PG_RW) {
+						self[lvl][vpn] = (self[lvl][vpn] & ~PG_RW) | PG_COW;
+						tlb_batch_add(&batch, vpn << PAGE_BITS);
+					}
+
+					share_page(PAGE_ENTRY_ADDR(self[lvl][vpn]));
+					atomic_int32_inc(&dest->user_usage);
+
+					other[lvl][vpn] = self[lvl][vpn];
+				}
+				else if (self[lvl][vpn] & PG_USER) {
+					size_t phyaddr = get_page();
 					if (BUILTIN_EXPECT(!phyaddr, 0))
-						return -ENOMEM;
+						goto fail;
 
 					atomic_int32_inc(&dest->user_usage);
 
+					/* PML4, PDPT, PGD */
 					other[lvl][vpn] = phyaddr | (self[lvl][vpn] & ~PAGE_MASK);
-					if (lvl) /* PML4, PDPT, PGD */
-						traverse(lvl-1, vpn<<PAGE_MAP_BITS); /* Pre-order traversal */
-					else { /* PGT */
-						page_map(PAGE_TMP, phyaddr, 1, PG_RW);
-						memcpy((void*) PAGE_TMP, (void*) (vpn<<PAGE_BITS), PAGE_SIZE);
-					}
+					if (traverse(lvl-1, vpn<<PAGE_MAP_BITS)) /* Pre-order traversal */
+						goto fail_next;
 				}
 				else if (self[lvl][vpn] & PG_SELF)
 					other[lvl][vpn] = 0;
@@ -247,55 +667,260 @@ int page_map_copy(task_t *dest)
 				other[lvl][vpn] = 0;
 		}
 		return 0;
+
+fail_next:
+		vpn++;
+fail:
+		/* Keep the partial copy consistent for the rollback */
+		for (; vpn<stop; vpn++)
+			other[lvl][vpn] = 0;
+		return -ENOMEM;
+	}
+
+	/* Release everything, which a failed traverse() already copied */
+	void rollback(int lvl, long vpn) {
+		long stop;
+		for (stop=vpn+PAGE_MAP_ENTRIES; vpn<stop; vpn++) {
+			/* Kernel tables are linked, not copied */
+			if (lvl && (vpn < KERNEL_ENTRIES(lvl)))
+				continue;
+
+			if ((other[lvl][vpn] & PG_PRESENT) && (other[lvl][vpn] & PG_USER)) {
+				/* Post-order traversal */
+				if (lvl)
+					rollback(lvl-1, vpn<<PAGE_MAP_BITS);
+
+				put_page(other[lvl][vpn] & PAGE_MASK);
+				atomic_int32_dec(&dest->user_usage);
+				other[lvl][vpn] = 0;
+			}
+		}
 	}
 
-	spinlock_irqsave_lock(&current_task->page_lock);
+#ifdef CONFIG_X86_32
+	/* The kernel tables are linked into each new page map. Hence, all
+	 * of them have to exist before the address spaces diverge. */
+	long i;
+
+	mutex_lock(&kslock);
+	for (i=0; i<KERNEL_ENTRIES(1); i++) {
+		if (!(self[1][i] & PG_PRESENT)) {
+			size_t phyaddr = get_page();
+			if (BUILTIN_EXPECT(!phyaddr, 0)) {
+				mutex_unlock(&kslock);
+				return -ENOMEM;
+			}
+
+			self[1][i] = phyaddr | PG_PRESENT | PG_USER | PG_RW;
+			memset(&self[0][i<<PAGE_MAP_BITS], 0, PAGE_SIZE);
+		}
+	}
+	mutex_unlock(&kslock);
+#endif
+
+	spinlock_irqsave_lock(&per_core(current_task)->page_lock);
 	self[PAGE_LEVELS-1][PAGE_MAP_ENTRIES-2] = dest->page_map | PG_PRESENT | PG_SELF | PG_RW;
 
 	int ret = traverse(PAGE_LEVELS-1, 0);
+	if (BUILTIN_EXPECT(ret, 0))
+		rollback(PAGE_LEVELS-1, 0);
 
 	other[PAGE_LEVELS-1][PAGE_MAP_ENTRIES-1] = dest->page_map | PG_PRESENT | PG_SELF | PG_RW;
 	self [PAGE_LEVELS-1][PAGE_MAP_ENTRIES-2] = 0;
-	spinlock_irqsave_unlock(&current_task->page_lock);
 
-	/* Flush TLB entries of 'other' self-reference */
-	flush_tlb();
+	/* Flush TLB entries of 'other' self-reference and write-protected pages */
+	tlb_batch_flush(&batch);
+	spinlock_irqsave_unlock(&per_core(current_task)->page_lock);
 
 	return ret;
 }
 
+/** @brief Resolve a write access to a copy-on-write page
+ *
+ * As long as the page frame is shared, the task gets its own copy.
+ * The last user just gets write access again.
+ *
+ * @return
+ * - 0 on success
+ * - -EINVAL (-22) if the page isn't a copy-on-write page
+ * - -ENOMEM (-12) if there is no free page frame for the copy
+ */
+static int page_cow_fault(size_t viraddr)
+{
+	task_t* task = per_core(current_task);
+	size_t vpn = viraddr >> PAGE_BITS;
+	size_t entry, phyaddr;
+	int ret = 0;
+	tlb_batch_t batch = TLB_BATCH_INIT;
+
+	spinlock_irqsave_lock(&task->page_lock);
+
+	entry = self[0][vpn];
+	if (!(entry & PG_PRESENT) || !(entry & PG_COW)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	if (page_is_shared(PAGE_ENTRY_ADDR(entry))) {
+		phyaddr = get_page();
+		if (BUILTIN_EXPECT(!phyaddr, 0)) {
+			ret = -ENOMEM;
+			goto out;
+		}
+
+		page_map_local(PAGE_TMP, phyaddr);
+		memcpy((void*) PAGE_TMP, (void*) (vpn << PAGE_BITS), PAGE_SIZE);
+
+		self[0][vpn] = ((entry & ~PG_COW) ^ PAGE_ENTRY_ADDR(entry)) | phyaddr | PG_RW;
+		tlb_batch_add(&batch, vpn << PAGE_BITS);
+
+		// drop our reference of the shared page frame
+		put_page(PAGE_ENTRY_ADDR(entry));
+	} else {
+		self[0][vpn] = (entry & ~PG_COW) | PG_RW;
+		tlb_batch_add(&batch, vpn << PAGE_BITS);
+	}
+
+out:
+	tlb_batch_flush(&batch);
+	spinlock_irqsave_unlock(&task->page_lock);
+
+	return ret;
+}
+
+/** @brief Map the heap pages around a faulting address
+ *
+ * The unmapped pages of an aligned window around the address are backed
+ * by zeroed page frames of the zero pool or by single page frames, which
+ * are zeroed afterwards. All of them are mapped by a single page_map_frames()
+ * call. The window grows while the task faults in quick succession and
+ * shrinks otherwise.
+ *
+ * @return
+ * - 0 on success
+ * - -ENOMEM (-12) if there is no free page frame
+ */
+static int page_fault_around(task_t* task, size_t viraddr)
+{
+	fault_stats_t* stats = &task->faults;
+	uint64_t now = get_clock_tick();
+	size_t start, end, first, last, npages, nzeroed, n;
+	size_t frames[FAULT_AROUND_MAX];
+	int ret;
+
+	if (!stats->window)
+		stats->window = FAULT_AROUND_MIN;
+	else if (now - stats->last_tick <= 1) {
+		if (stats->window < FAULT_AROUND_MAX)
+			stats->window <<= 1;
+	} else if (stats->window > FAULT_AROUND_MIN)
+		stats->window >>= 1;
+	stats->last_tick = now;
+
+	// aligned window, limited to the heap
+	start = viraddr & ~((stats->window << PAGE_BITS) - 1);
+	end = start + (stats->window << PAGE_BITS);
+	if (start < task->heap->start)
+		start = task->heap->start;
+	if (end > PAGE_FLOOR(task->heap->end))
+		end = PAGE_FLOOR(task->heap->end);
+
+	// unmapped run around the faulting page
+	for (first=viraddr; first>start && !virt_to_phys(first-PAGE_SIZE); first-=PAGE_SIZE);
+	for (last=viraddr+PAGE_SIZE; last<end && !virt_to_phys(last); last+=PAGE_SIZE);
+
+	npages = (last - first) >> PAGE_BITS;
+
+	// first use the pre-zeroed page frames of the idle task...
+	nzeroed = get_zeroed_pages(frames, npages);
+
+	// ... and single page frames for the rest (no contiguous run required)
+	for (n=nzeroed; n<npages; n++) {
+		frames[n] = get_page();
+		if (BUILTIN_EXPECT(!frames[n], 0))
+			break;
+	}
+
+	if (BUILTIN_EXPECT(!n, 0))
+		return -ENOMEM;
+
+	// not enough page frames for the run => start at the faulting page
+	if (first + (n << PAGE_BITS) <= viraddr) {
+		first = viraddr;
+		while (first + (n << PAGE_BITS) > last) {
+			put_page(frames[--n]);
+			if (n < nzeroed)
+				nzeroed = n;
+		}
+	}
+
+	ret = page_map_frames(first, frames, n, PG_USER|PG_RW);
+	if (BUILTIN_EXPECT(ret, 0)) {
+		kprintf("map_region: could not map %lu pages to %#lx, task = %u\n", n, first, task->id);
+		while (n)
+			put_page(frames[--n]);
+		return ret;
+	}
+
+	// zero the page frames, which don't stem from the pool
+	if (n > nzeroed)
+		memset((void*) (first + (nzeroed << PAGE_BITS)), 0x00, (n - nzeroed) << PAGE_BITS);
+
+	stats->heap_faults++;
+	stats->saved_faults += n - 1;
+
+	return 0;
+}
+
 void page_fault_handler(struct state *s)
 {
 	size_t viraddr = read_cr2();
-	task_t* task = current_task;
+	task_t* task = per_core(current_task);
+
+	if (s->error & 0x1) {
+		// write access to a present page => copy-on-write?
+		if ((s->error & 0x2) && !page_cow_fault(viraddr))
+			return;
+
+		// demand paging would replace the present page
+		goto default_handler;
+	}
+
+	// faults of different cores don't serialize on the VMA lookup
+	read_lock(&task->vma_lock);
 
 	// on demand userspace heap mapping
 	if ((task->heap) && (viraddr >= task->heap->start) && (viraddr < task->heap->end)) {
-		viraddr &= PAGE_MASK;
+		int ret = page_fault_around(task, viraddr & PAGE_MASK);
+		read_unlock(&task->vma_lock);
 
-		size_t phyaddr = get_page();
-		if (BUILTIN_EXPECT(!phyaddr, 0)) {
+		if (BUILTIN_EXPECT(ret == -ENOMEM, 0))
 			kprintf("out of memory: task = %u\n", task->id);
+		if (BUILTIN_EXPECT(ret, 0))
 			goto default_handler;
-		}
-
-		int ret = page_map(viraddr, phyaddr, 1, PG_USER|PG_RW);
-		if (BUILTIN_EXPECT(ret, 0)) {
-			kprintf("map_region: could not map %#lx to %#lx, task = %u\n", phyaddr, viraddr, task->id);
-			put_page(phyaddr);
 
-			goto default_handler;
-		}
+		return;
+	}
 
-		memset((void*) viraddr, 0x00, PAGE_SIZE); // fill with zeros
+	read_unlock(&task->vma_lock);
 
+default_handler:
+	// an invalid user buffer aborts copy_user() instead of the kernel
+#ifdef CONFIG_X86_32
+	if (!(s->error & 0x4) && (s->eip == (size_t) &copy_user_fault)) {
+		s->eip = (size_t) &copy_user_fixup;
+		return;
+	}
+#elif defined(CONFIG_X86_64)
+	if (!(s->error & 0x4) && (s->rip == (size_t) &copy_user_fault)) {
+		s->rip = (size_t) &copy_user_fixup;
 		return;
 	}
+#endif
 
-default_handler:
 #ifdef CONFIG_X86_32
 	kprintf("Page Fault Exception (%d) at cs:ip = %#x:%#lx, task = %u, addr = %#lx, error = %#x [ %s %s %s %s %s ]\n",
-		s->int_no, s->cs, s->eip, current_task->id, viraddr, s->error,
+		s->int_no, s->cs, s->eip, per_core(current_task)->id, viraddr, s->error,
 		(s->error & 0x4) ? "user" : "supervisor",
 		(s->error & 0x10) ? "instruction" : "data",
 		(s->error & 0x2) ? "write" : ((s->error & 0x10) ? "fetch" : "read"),
@@ -303,7 +928,7 @@ default_handler:
 		(s->error & 0x8) ? "reserved bit" : "\b");
 #elif defined(CONFIG_X86_64)
 	kprintf("Page Fault Exception (%d) at cs:ip = %#x:%#lx, task = %u, addr = %#lx, error = %#x [ %s %s %s %s %s ]\n",
-		s->int_no, s->cs, s->rip, current_task->id, viraddr, s->error,
+		s->int_no, s->cs, s->rip, per_core(current_task)->id, viraddr, s->error,
 		(s->error & 0x4) ? "user" : "supervisor",
 		(s->error & 0x10) ? "instruction" : "data",
 		(s->error & 0x2) ? "write" : ((s->error & 0x10) ? "fetch" : "read"),
@@ -322,6 +947,21 @@ int page_init(void)
 	/* Replace default pagefault handler */
 	irq_uninstall_handler(14);
 	irq_install_handler(14, page_fault_handler);
+#if MAX_CORES > 1
+	irq_install_handler(122, tlb_shootdown_handler);
+#endif
+
+	/* Create the tables of the temporary pages (see page_map_local()) */
+	mutex_lock(&kslock);
+	addr = PAGE_FLOOR((size_t) &kernel_start) - (2+2*MAX_CORES)*PAGE_SIZE;
+	for (i=0; i<2*MAX_CORES; i++, addr+=PAGE_SIZE) {
+		if (BUILTIN_EXPECT(page_walk(addr >> PAGE_BITS, 0, PG_RW|PG_GLOBAL), 0)) {
+			mutex_unlock(&kslock);
+			return -ENOMEM;
+		}
+	}
+	mutex_unlock(&kslock);
+
 
 	/* Map multiboot information and modules */
 	if (mb_info) {
@@ -340,7 +980,7 @@ int page_init(void)
 			for(i=0; i<mb_info->mods_count; i++) {
 				addr = mmodule[i].mod_start;
 				npages = PAGE_FLOOR(mmodule[i].mod_end - mmodule[i].mod_start) >> PAGE_BITS;
-				page_map(addr, addr, npages, PG_GLOBAL);
+				page_map(addr, addr, npages, PG_GLOBAL|PG_HUGE);
 				kprintf("Map modules at 0x%lx\n", addr);
 			}
 		}
@@ -31,9 +31,14 @@
 #include <eduos/fs.h>
 #include <eduos/errno.h>
 #include <eduos/spinlock.h>
+#include <eduos/rwlock.h>
 
 vfs_node_t* fs_root = NULL;		// The root of the filesystem.
 
+kmem_cache_t vfs_node_cache = KMEM_CACHE_INIT("vfs_node", sizeof(vfs_node_t));
+kmem_cache_t block_list_cache = KMEM_CACHE_INIT("block_list", sizeof(block_list_t));
+kmem_cache_t fildes_cache = KMEM_CACHE_INIT("fildes", sizeof(fildes_t));
+
 ssize_t read_fs(fildes_t* file, uint8_t* buffer, size_t size)
 {
 	vfs_node_t* node = file->node;
@@ -42,11 +47,11 @@ ssize_t read_fs(fildes_t* file, uint8_t* buffer, size_t size)
 	if (BUILTIN_EXPECT(!node || !buffer, 0))
 		return ret;
 
-	spinlock_lock(&node->lock);
+	read_lock(&node->lock);
 	// Has the node got a read callback?
 	if (node->read != 0)
 		ret = node->read(file, buffer, size);
-	spinlock_unlock(&node->lock);
+	read_unlock(&node->lock);
 
 	return ret;
 }
@@ -59,11 +64,11 @@ ssize_t write_fs(fildes_t* file, uint8_t* buffer, size_t size)
 	if (BUILTIN_EXPECT(!node || !buffer, 0))
 		return ret;
 
-	spinlock_lock(&node->lock);
+	write_lock(&node->lock);
 	// Has the node got a write callback?
 	if (node->write != 0)
 		ret = node->write(file, buffer, size);
-	spinlock_unlock(&node->lock);
+	write_unlock(&node->lock);
 
 	return ret;
 }
@@ -98,19 +103,37 @@ int open_fs(fildes_t* file, const char* name)
 
 	/* file exists */
 	if(file_node) {
-		spinlock_lock(&file_node->lock);
+		/* only O_TRUNC modifies an existing node */
+		int modify = (file_node->type == FS_FILE) && (file->flags & O_TRUNC);
+
+		if (modify)
+			write_lock(&file_node->lock);
+		else
+			read_lock(&file_node->lock);
 		file->node = file_node;
 		// Has the file_node got an open callback?
 		if (file_node->open != 0)
 			ret = file->node->open(file, NULL);
-		spinlock_unlock(&file_node->lock);
-	} else if (dir_node) { /* file doesn't exist or opendir was called */
-		spinlock_lock(&dir_node->lock);
+		if (modify)
+			write_unlock(&file_node->lock);
+		else
+			read_unlock(&file_node->lock);
+	} else if (dir_node && fname[0] && !(file->flags & O_CREAT)) {
+		/* only O_CREAT creates a missing file */
+		ret = -ENOENT;
+	} else if (dir_node && fname[0]) { /* file doesn't exist => create it */
+		write_lock(&dir_node->lock);
 		file->node = dir_node;
 		// Has the dir_node got an open callback?
 		if (dir_node->open != 0)
 			ret = dir_node->open(file, fname);
-		spinlock_unlock(&dir_node->lock);
+		write_unlock(&dir_node->lock);
+	} else if (dir_node) { /* opendir was called */
+		read_lock(&dir_node->lock);
+		file->node = dir_node;
+		if (dir_node->open != 0)
+			ret = dir_node->open(file, fname);
+		read_unlock(&dir_node->lock);
 	} else {
 		ret = -ENOENT;
 	}
@@ -125,11 +148,11 @@ int close_fs(fildes_t* file)
 	if (BUILTIN_EXPECT(!(file->node), 0))
 		return ret;
 
-	spinlock_lock(&file->node->lock);
+	read_lock(&file->node->lock);
 	// Has the node got a close callback?
 	if (file->node->close != 0)
 		ret = file->node->close(file);
-	spinlock_unlock(&file->node->lock);
+	read_unlock(&file->node->lock);
 
 	return ret;
 }
@@ -141,11 +164,11 @@ struct dirent* readdir_fs(vfs_node_t * node, uint32_t index)
 	if (BUILTIN_EXPECT(!node, 0))
 		return ret;
 
-	spinlock_lock(&node->lock);
+	read_lock(&node->lock);
 	// Is the node a directory, and does it have a callback?
 	if ((node->type == FS_DIRECTORY) && node->readdir != 0)
 		ret = node->readdir(node, index);
-	spinlock_unlock(&node->lock);
+	read_unlock(&node->lock);
 
 	return ret;
 }
@@ -157,11 +180,11 @@ vfs_node_t* finddir_fs(vfs_node_t* node, const char *name)
 	if (BUILTIN_EXPECT(!node, 0))
 		return ret;
 
-	spinlock_lock(&node->lock);
+	read_lock(&node->lock);
 	// Is the node a directory, and does it have a callback?
 	if ((node->type == FS_DIRECTORY) && node->finddir != 0)
 		ret = node->finddir(node, name);
-	spinlock_unlock(&node->lock);
+	read_unlock(&node->lock);
 
 	return ret;
 }
@@ -173,10 +196,10 @@ vfs_node_t* mkdir_fs(vfs_node_t* node, const char *name)
 	if (BUILTIN_EXPECT(!node, 0))
 		return ret;
 
-	spinlock_lock(&node->lock);
+	write_lock(&node->lock);
 	if (node->mkdir != 0)
 		ret = node->mkdir(node, name);
-	spinlock_unlock(&node->lock);
+	write_unlock(&node->lock);
 
 	return ret;
 }
@@ -212,7 +235,7 @@ void list_fs(vfs_node_t* node, uint32_t depth)
 {
 	int j, i = 0;
 	dirent_t* dirent = NULL;
-	fildes_t* file = kmalloc(sizeof(fildes_t));
+	fildes_t* file = kmem_cache_alloc(&fildes_cache);
 	file->offset = 0;
 	file->flags = 0;
 
@@ -242,5 +265,5 @@ void list_fs(vfs_node_t* node, uint32_t depth)
 
 		i++;
 	}
-	kfree(file);
+	kmem_cache_free(&fildes_cache, file);
 }
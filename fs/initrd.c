@@ -31,6 +31,7 @@
 #include <eduos/fs.h>
 #include <eduos/errno.h>
 #include <eduos/spinlock.h>
+#include <eduos/rwlock.h>
 #include <asm/multiboot.h>
 #include <asm/processor.h>
 
@@ -70,6 +71,10 @@ static ssize_t initrd_read(fildes_t* file, uint8_t* buffer, size_t size)
 	if (file->flags & O_WRONLY)
 		return -EACCES;
 
+	/* end of file (also covers empty files without data blocks) */
+	if ((size_t) file->offset >= node->block_size)
+		return 0;
+
 	/* init the tmp offset */
 	offset = file->offset;
 
@@ -186,7 +191,7 @@ static ssize_t initrd_write(fildes_t* file, uint8_t* buffer, size_t size)
 
 		if (!blist->next) {
 			blist->next = (block_list_t*) 
-				kmalloc(sizeof(block_list_t));
+				kmem_cache_alloc(&block_list_cache);
 			if (blist->next) 
 				memset(blist->next, 0x00, 
 					sizeof(block_list_t));
@@ -241,7 +246,7 @@ static int initrd_open(fildes_t* file, const char* name)
 					}
 					lastblist = blist;
 					blist = blist->next;
-					kfree(lastblist);
+					kmem_cache_free(&block_list_cache, lastblist);
 				} while(blist);
 			}
 
@@ -263,7 +268,7 @@ static int initrd_open(fildes_t* file, const char* name)
 		uint32_t i, j;
 		block_list_t* blist = NULL;
 		/* CREATE FILE */
-		vfs_node_t* new_node = kmalloc(sizeof(vfs_node_t));
+		vfs_node_t* new_node = kmem_cache_alloc(&vfs_node_cache);
 		if (BUILTIN_EXPECT(!new_node, 0))
 			return -EINVAL;
 		
@@ -276,7 +281,7 @@ static int initrd_open(fildes_t* file, const char* name)
 		new_node->read = initrd_read;
 		new_node->write = initrd_write;
 		new_node->open = initrd_open;
-		spinlock_init(&new_node->lock);
+		rwlock_init(&new_node->lock);
 
 		/* create a entry for the new node in the directory block of current node */
 		do {
@@ -295,7 +300,7 @@ static int initrd_open(fildes_t* file, const char* name)
  			}
 			 /* if all blocks are reserved, we have  to allocate a new one */
 			if (!blist->next) {
-				blist->next = (block_list_t*) kmalloc(sizeof(block_list_t));
+				blist->next = (block_list_t*) kmem_cache_alloc(&block_list_cache);
 				if (blist->next)
 					memset(blist->next, 0x00, sizeof(block_list_t));
 			}
@@ -377,7 +382,7 @@ static vfs_node_t* initrd_mkdir(vfs_node_t* node, const char* name)
 	if (initrd_finddir(node, name))
 		return NULL;
 
-	new_node = kmalloc(sizeof(vfs_node_t));
+	new_node = kmem_cache_alloc(&vfs_node_cache);
 	if (BUILTIN_EXPECT(!new_node, 0))
 		return NULL;
 
@@ -388,7 +393,7 @@ static vfs_node_t* initrd_mkdir(vfs_node_t* node, const char* name)
 	new_node->finddir = &initrd_finddir;
 	new_node->mkdir = &initrd_mkdir;
 	new_node->open = &initrd_open;
-	spinlock_init(&new_node->lock);
+	rwlock_init(&new_node->lock);
 
 	/* create default directory entry */
 	dir_block = (dir_block_t*) kmalloc(sizeof(dir_block_t));
@@ -419,7 +424,7 @@ static vfs_node_t* initrd_mkdir(vfs_node_t* node, const char* name)
 
 		/* if all blocks are reserved, we have  to allocate a new one */
 		if (!blist->next) {
-			blist->next = (block_list_t*) kmalloc(sizeof(block_list_t));
+			blist->next = (block_list_t*) kmem_cache_alloc(&block_list_cache);
 			if (blist->next)
 				memset(blist->next, 0x00, sizeof(block_list_t));
 		}
@@ -429,7 +434,7 @@ static vfs_node_t* initrd_mkdir(vfs_node_t* node, const char* name)
 
 	kfree(dir_block);
 out:
-	kfree(new_node);
+	kmem_cache_free(&vfs_node_cache, new_node);
 
 	return NULL;
 }
@@ -456,7 +461,7 @@ int initrd_init(void)
 	initrd_root.finddir = &initrd_finddir;
 	initrd_root.mkdir = &initrd_mkdir;
 	initrd_root.open = &initrd_open;
-	spinlock_init(&initrd_root.lock);
+	rwlock_init(&initrd_root.lock);
 
 	/* create default directory block */
 	dir_block = (dir_block_t*) kmalloc(sizeof(dir_block_t));
@@ -514,7 +519,7 @@ int initrd_init(void)
 			}
 
 			/* create a new node and map the module as data block */
-			new_node = kmalloc(sizeof(vfs_node_t));
+			new_node = kmem_cache_alloc(&vfs_node_cache);
 			if (BUILTIN_EXPECT(!new_node, 0)) {
 				kprintf("Not enough memory to create new initrd node\n");
 				goto next_file;
@@ -526,7 +531,7 @@ int initrd_init(void)
 			new_node->open = initrd_open;
 			new_node->block_size = file_desc->length;
 			new_node->block_list.data[0] = ((char*) header) + file_desc->offset;
-			spinlock_init(&new_node->lock);
+			rwlock_init(&new_node->lock);
 
 			/* create a entry for the new node in the directory block of current node */
 			blist = &tmp->block_list;
@@ -547,7 +552,7 @@ int initrd_init(void)
 
 				 /* if all blocks are reserved, we have  to allocate a new one */
 	 			if (!blist->next) {
-					blist->next = (block_list_t*) kmalloc(sizeof(block_list_t));
+					blist->next = (block_list_t*) kmem_cache_alloc(&block_list_cache);
 					if (blist->next)
 						memset(blist->next, 0x00, sizeof(block_list_t));
 				}
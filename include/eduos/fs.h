@@ -36,6 +36,8 @@
 
 #include <eduos/stddef.h>
 #include <eduos/spinlock_types.h>
+#include <eduos/rwlock_types.h>
+#include <eduos/slab.h>
 
 #define FS_FILE		0x01
 #define FS_DIRECTORY	0x02
@@ -153,8 +155,8 @@ typedef struct vfs_node {
 	finddir_type_t finddir;
 	/// Make dir handler function pointer
 	mkdir_type_t mkdir;
-	/// Lock variable to thread-protect this structure
-	spinlock_t lock;
+	/// Lock variable to thread-protect this structure (lookups are readers)
+	rwlock_t lock;
 	/// Block size
 	size_t block_size;
 	/// List of blocks
@@ -215,6 +217,11 @@ struct stat
 
 extern vfs_node_t* fs_root;	// The root of the filesystem.
 
+/// Object caches for VFS nodes, block lists and file descriptors
+extern kmem_cache_t vfs_node_cache;
+extern kmem_cache_t block_list_cache;
+extern kmem_cache_t fildes_cache;
+
 /** @defgroup fsfunc FS related functions
  *
  * Standard read/write/open/close/mkdir functions. Note that these are all suffixed with
@@ -111,6 +111,23 @@ extern "C" {
 		return 0; \
 	} \
 	\
+	inline static int mailbox_##name##_fetch_timeout(mailbox_##name##_t* m, type* mail, uint32_t ms) { \
+		int err; \
+	\
+		if (BUILTIN_EXPECT(!m || !mail, 0)) \
+			return -EINVAL; \
+	\
+		err = sem_timedwait(&m->mails, ms); \
+		if (err) return err; \
+		spinlock_lock(&m->rlock); \
+		*mail = m->buffer[m->rpos]; \
+		m->rpos = (m->rpos+1) % MAILBOX_SIZE; \
+		spinlock_unlock(&m->rlock); \
+		sem_post(&m->boxes); \
+	\
+		return 0; \
+	} \
+	\
 	inline static int mailbox_##name##_tryfetch(mailbox_##name##_t* m, type* mail) { \
 		if (BUILTIN_EXPECT(!m || !mail, 0)) \
 			return -EINVAL; \
@@ -135,6 +152,147 @@ MAILBOX(uint16, uint16_t)
 MAILBOX(uint8, uint8_t)
 MAILBOX(ptr, void*)
 
+/*
+ * Lock-free mailbox for a single producer (e.g. an interrupt handler)
+ * and a single consumer. The producer never blocks. The consumer
+ * sleeps on the semaphore, only if the ring is empty.
+ */
+#define MAILBOX_SPSC(name, type) 	\
+	inline static int mailbox_spsc_##name##_init(mailbox_spsc_##name##_t* m) { \
+		if (BUILTIN_EXPECT(!m, 0)) \
+			return -EINVAL; \
+	\
+		memset(m->buffer, 0x00, sizeof(type)*MAILBOX_SIZE); \
+		m->wpos = m->rpos = 0; \
+		atomic_int32_set(&m->waiting, 0); \
+		sem_init(&m->mails, 0); \
+	\
+		return 0; \
+	}\
+	\
+	inline static int mailbox_spsc_##name##_destroy(mailbox_spsc_##name##_t* m) { \
+		if (BUILTIN_EXPECT(!m, 0)) \
+			return -EINVAL; \
+	\
+		sem_destroy(&m->mails); \
+	\
+		return 0; \
+	} \
+	\
+	inline static int mailbox_spsc_##name##_post_n(mailbox_spsc_##name##_t* m, type* mails, uint32_t n) { \
+		uint32_t i, wpos, space; \
+	\
+		if (BUILTIN_EXPECT(!m || !mails, 0)) \
+			return -EINVAL; \
+	\
+		wpos = m->wpos; \
+		space = MAILBOX_SIZE - (wpos - atomic_load_acquire(&m->rpos)); \
+		if (n > space) \
+			n = space; \
+		for(i=0; i<n; i++) \
+			m->buffer[(wpos+i) % MAILBOX_SIZE] = mails[i]; \
+		atomic_store_release(&m->wpos, wpos+n); \
+	\
+		/* xchg is a full barrier => the consumer sees the new index */ \
+		if (n && atomic_int32_test_and_set(&m->waiting, 0)) \
+			sem_post(&m->mails); \
+	\
+		return n; \
+	} \
+	\
+	inline static int mailbox_spsc_##name##_post(mailbox_spsc_##name##_t* m, type mail) { \
+		int ret = mailbox_spsc_##name##_post_n(m, &mail, 1); \
+	\
+		if (ret < 0) \
+			return ret; \
+		return ret ? 0 : -EBUSY; \
+	} \
+	\
+	inline static int mailbox_spsc_##name##_wait(mailbox_spsc_##name##_t* m, int timed, uint32_t ms) { \
+		int err; \
+	\
+		while (m->rpos == atomic_load_acquire(&m->wpos)) { \
+			/* announce the sleep and check again (xchg is a full barrier) */ \
+			atomic_int32_test_and_set(&m->waiting, 1); \
+			if (m->rpos != atomic_load_acquire(&m->wpos)) { \
+				atomic_int32_test_and_set(&m->waiting, 0); \
+				break; \
+			} \
+	\
+			err = timed ? sem_timedwait(&m->mails, ms) : sem_wait(&m->mails); \
+			if (err) { \
+				atomic_int32_test_and_set(&m->waiting, 0); \
+				return err; \
+			} \
+		} \
+	\
+		return 0; \
+	} \
+	\
+	inline static int mailbox_spsc_##name##_read_n(mailbox_spsc_##name##_t* m, type* mails, uint32_t n) { \
+		uint32_t i, rpos = m->rpos; \
+		uint32_t avail = atomic_load_acquire(&m->wpos) - rpos; \
+	\
+		if (n > avail) \
+			n = avail; \
+		for(i=0; i<n; i++) \
+			mails[i] = m->buffer[(rpos+i) % MAILBOX_SIZE]; \
+		atomic_store_release(&m->rpos, rpos+n); \
+	\
+		return n; \
+	} \
+	\
+	inline static int mailbox_spsc_##name##_fetch_n(mailbox_spsc_##name##_t* m, type* mails, uint32_t n) { \
+		int err; \
+	\
+		if (BUILTIN_EXPECT(!m || !mails || !n, 0)) \
+			return -EINVAL; \
+	\
+		err = mailbox_spsc_##name##_wait(m, 0, 0); \
+		if (err) return err; \
+	\
+		return mailbox_spsc_##name##_read_n(m, mails, n); \
+	} \
+	\
+	inline static int mailbox_spsc_##name##_fetch(mailbox_spsc_##name##_t* m, type* mail) { \
+		int ret = mailbox_spsc_##name##_fetch_n(m, mail, 1); \
+	\
+		return (ret < 0) ? ret : 0; \
+	} \
+	\
+	inline static int mailbox_spsc_##name##_fetch_timeout(mailbox_spsc_##name##_t* m, type* mail, uint32_t ms) { \
+		int err; \
+	\
+		if (BUILTIN_EXPECT(!m || !mail, 0)) \
+			return -EINVAL; \
+	\
+		err = mailbox_spsc_##name##_wait(m, 1, ms); \
+		if (err) return err; \
+	\
+		mailbox_spsc_##name##_read_n(m, mail, 1); \
+	\
+		return 0; \
+	} \
+	\
+	inline static int mailbox_spsc_##name##_tryfetch(mailbox_spsc_##name##_t* m, type* mail) { \
+		if (BUILTIN_EXPECT(!m || !mail, 0)) \
+			return -EINVAL; \
+	\
+		if (!mailbox_spsc_##name##_read_n(m, mail, 1)) \
+			return -EINVAL; \
+	\
+		return 0; \
+	}\
+
+MAILBOX_SPSC(wait_msg, wait_msg_t)
+MAILBOX_SPSC(int32, int32_t)
+MAILBOX_SPSC(int16, int16_t)
+MAILBOX_SPSC(int8, int8_t)
+MAILBOX_SPSC(uint32, uint32_t)
+MAILBOX_SPSC(uint16, uint16_t)
+MAILBOX_SPSC(uint8, uint8_t)
+MAILBOX_SPSC(ptr, void*)
+
 #ifdef __cplusplus
 }
 #endif
@@ -35,6 +35,7 @@
 #define __MAILBOX_TYPES_H__
 
 #include <eduos/semaphore_types.h>
+#include <asm/atomic.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -68,6 +69,29 @@ MAILBOX_TYPES(uint16, uint16_t)
 MAILBOX_TYPES(uint8, uint8_t)
 MAILBOX_TYPES(ptr, void*)
 
+/*
+ * Ring buffer for a single producer and a single consumer. The indices
+ * run freely and are only modified by their owner. Therefore,
+ * MAILBOX_SIZE has to be a power of two. The semaphore is only used,
+ * if the consumer has to sleep.
+ */
+#define MAILBOX_SPSC_TYPES(name, type) 	\
+	typedef struct mailbox_spsc_##name { \
+		type buffer[MAILBOX_SIZE]; \
+		volatile uint32_t wpos, rpos; \
+		atomic_int32_t waiting; \
+		sem_t mails; \
+	} mailbox_spsc_##name##_t;
+
+MAILBOX_SPSC_TYPES(wait_msg, wait_msg_t)
+MAILBOX_SPSC_TYPES(int32, int32_t)
+MAILBOX_SPSC_TYPES(int16, int16_t)
+MAILBOX_SPSC_TYPES(int8, int8_t)
+MAILBOX_SPSC_TYPES(uint32, uint32_t)
+MAILBOX_SPSC_TYPES(uint16, uint16_t)
+MAILBOX_SPSC_TYPES(uint8, uint8_t)
+MAILBOX_SPSC_TYPES(ptr, void*)
+
 #ifdef __cplusplus
 }
 #endif
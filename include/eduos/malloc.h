@@ -42,12 +42,13 @@ extern "C" {
 /// Binary exponent of maximal size for kmalloc()
 #define BUDDY_MAX	32 // 4 GB
 /// Binary exponent of minimal buddy size
-#define BUDDY_MIN	3  // 8 Byte >= sizeof(buddy_t)
+#define BUDDY_MIN	5  // 32 Byte >= 3 * sizeof(buddy_t) (prefix, next & prev)
 /// Binary exponent of the size which we allocate with buddy_fill()
 #define BUDDY_ALLOC	16 // 64 KByte = 16 * PAGE_SIZE
 
 #define BUDDY_LISTS	(BUDDY_MAX-BUDDY_MIN+1)
 #define BUDDY_MAGIC	0xBABE
+#define BUDDY_FREE	0xF4EE
 
 union buddy;
 
@@ -62,10 +63,18 @@ union buddy;
  * Every allocated memory block is prefixed with its binary size exponent and
  *  a known magic number. This prefix is hidden by the user because its located
  *  before the actual memory address returned by kmalloc()
+ *
+ * Free blocks keep their prefix (with BUDDY_FREE as magic) and store the
+ *  pointers to the next and previous free block directly behind it.
+ *  Hence, a free block is unlinked in constant time. Blocks are naturally
+ *  aligned to their size, so the buddy of a block is found by flipping
+ *  the bit of its size in the address.
  */
 typedef union buddy {
-	/// Pointer to the next buddy in the linked list.
+	/// Pointer to the next buddy in the linked list (second slot of a free block)
 	union buddy* next;
+	/// Pointer to the previous buddy in the linked list (third slot of a free block)
+	union buddy* prev;
 	struct {
 		/// The binary exponent of the block size
 		uint8_t exponent;
@@ -74,6 +83,22 @@ typedef union buddy {
 	} prefix;
 } buddy_t;
 
+/** @brief Allocate a block of 2^exp bytes without prefix
+ *
+ * The block is aligned to its size. It is used by allocators,
+ * which build on top of the buddy system (e.g. the slab caches).
+ *
+ * @return Pointer to the block or NULL on failure
+ */
+void* buddy_alloc(int exp);
+
+/** @brief Release a block which was allocated by buddy_alloc()
+ *
+ * @param addr Address of the block
+ * @param exp Binary size exponent, which was passed to buddy_alloc()
+ */
+void buddy_free(void* addr, int exp);
+
 /** @brief Dump free buddies */
 void buddy_dump(void);
 
@@ -44,27 +44,68 @@ size_t get_pages(size_t npages);
 
 /** @brief Get a single page
  *
- * Convenience function: uses get_pages(1);
+ * The page frame is taken from a per-core cache, which is refilled
+ * in batches from the page frame allocator.
  */
-static inline size_t get_page(void) { return get_pages(1); }
+size_t get_page(void);
+
+/** @brief Get a single page, which is already filled with zeros
+ *
+ * The page frame is taken from a per-core pool, which the idle task fills.
+ *
+ * @return
+ * - physical address of the page frame
+ * - 0 if the pool is empty
+ */
+size_t get_zeroed_page(void);
+
+/** @brief Get several pages, which are already filled with zeros
+ *
+ * @param pages Array for the physical addresses of the page frames
+ * @param npages Maximal number of page frames
+ * @return Number of page frames, which were taken from the pool
+ */
+size_t get_zeroed_pages(size_t* pages, size_t npages);
+
+/** @brief Add a zeroed page frame to the pool of this core
+ *
+ * Called by the idle task.
+ *
+ * @return
+ * - 1 if a page frame was added
+ * - 0 if the pool is full or no page frame is available
+ */
+int zero_pool_fill(void);
 
 /** @brief release physical page frames */
 int put_pages(size_t phyaddr, size_t npages);
 
+/** @brief Add a mapping to a page frame
+ *
+ * A shared page frame is released by the last put_page() or put_page_cold().
+ *
+ * @return
+ * - 0 on success
+ * - -EINVAL (-22) on failure
+ */
+int share_page(size_t phyaddr);
+
+/** @brief Check if a page frame is mapped more than once */
+int page_is_shared(size_t phyaddr);
+
 /** @brief Put a single page
  *
- * Convenience function: uses put_pages(1);
+ * If the page frame is shared, only one reference is dropped.
+ * Otherwise, the page frame is kept hot in a per-core cache, which is drained
+ * in batches to the page frame allocator.
  */
-static inline int put_page(size_t phyaddr) { return put_pages(phyaddr, 1); }
+int put_page(size_t phyaddr);
 
-/** @brief Copy a physical page frame
+/** @brief Put a single page, which was not used recently
  *
- * @param psrc physical address of source page frame
- * @param pdest physical address of source page frame
- * @return
- * - 0 on success
- * - -1 on failure
+ * Like put_page(), but the page frame is the first to be drained
+ * (e.g. for the page tables of a dead task).
  */
-int copy_page(size_t pdest, size_t psrc);
+int put_page_cold(size_t phyaddr);
 
 #endif
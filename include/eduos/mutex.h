@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2026
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the University nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file include/eduos/mutex.h
+ * @brief Adaptive mutex
+ *
+ * A mutex protects long critical sections. A waiter spins for a
+ * bounded number of iterations while the owner is running. Afterwards,
+ * it blocks until the owner releases the mutex.
+ */
+
+#ifndef __MUTEX_H__
+#define __MUTEX_H__
+
+#include <eduos/stddef.h>
+#include <eduos/mutex_types.h>
+#include <eduos/spinlock.h>
+#include <eduos/tasks.h>
+#include <eduos/errno.h>
+#include <asm/atomic.h>
+#include <asm/processor.h>
+#include <asm/irqflags.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Maximal number of iterations, which a waiter spins before it blocks
+#define MUTEX_SPIN_COUNT	1000
+
+/** @brief Initialization of a mutex
+ *
+ * @param m Pointer to the mutex structure to initialize.
+ * @return
+ * - 0 on success
+ * - -EINVAL (-22) on failure
+ */
+inline static int mutex_init(mutex_t* m) {
+	if (BUILTIN_EXPECT(!m, 0))
+		return -EINVAL;
+
+	atomic_int32_set(&m->value, 0);
+	m->owner = NULL;
+	m->counter = 0;
+	m->first = m->last = NULL;
+	spinlock_irqsave_init(&m->lock);
+
+	return 0;
+}
+
+/** @brief Destroy mutex after use
+ * @return
+ * - 0 on success
+ * - -EINVAL (-22) on failure
+ */
+inline static int mutex_destroy(mutex_t* m) {
+	if (BUILTIN_EXPECT(!m, 0))
+		return -EINVAL;
+
+	m->owner = NULL;
+	m->counter = 0;
+	spinlock_irqsave_destroy(&m->lock);
+
+	return 0;
+}
+
+/** @brief Try to acquire a free mutex
+ *
+ * xchg is a full barrier. Therefore, a waiter, which is queued before
+ * the test, is seen by the following unlock.
+ */
+inline static int mutex_tryacquire(mutex_t* m) {
+	return !atomic_int32_test_and_set(&m->value, 1);
+}
+
+/** @brief Lock mutex at entry of critical section
+ *
+ * The caller blocks only, if the interrupts are enabled and if it isn't
+ * an idle task. Otherwise, it spins until the mutex is released.
+ *
+ * @return
+ * - 0 on success
+ * - -EINVAL (-22) on failure
+ */
+inline static int mutex_lock(mutex_t* m) {
+	task_t* curr_task;
+	task_t* owner;
+	uint32_t i;
+
+	if (BUILTIN_EXPECT(!m, 0))
+		return -EINVAL;
+
+	curr_task = per_core(current_task);
+	if (m->owner == curr_task) {
+		m->counter++;
+		return 0;
+	}
+
+	while (!mutex_tryacquire(m)) {
+		// spin as long as the owner is running
+		for(i=0; (i<MUTEX_SPIN_COUNT) && atomic_int32_read(&m->value); i++) {
+			owner = m->owner;
+			if (owner && (owner->status != TASK_RUNNING))
+				break;
+			PAUSE;
+		}
+
+		if (!atomic_int32_read(&m->value))
+			continue;
+
+		// we aren't able to block => spin
+		if (!is_irq_enabled() || (curr_task->status == TASK_IDLE)) {
+			tlb_shootdown_poll();
+			PAUSE;
+			continue;
+		}
+
+		spinlock_irqsave_lock(&m->lock);
+
+		// append the task to the wait queue
+		curr_task->wait_next = NULL;
+		curr_task->wait_prev = m->last;
+		if (m->last)
+			m->last->wait_next = curr_task;
+		else
+			m->first = curr_task;
+		m->last = curr_task;
+
+		// the owner may have released the mutex in the meantime
+		if (mutex_tryacquire(m)) {
+			if (curr_task->wait_prev)
+				curr_task->wait_prev->wait_next = NULL;
+			else
+				m->first = NULL;
+			m->last = curr_task->wait_prev;
+			curr_task->wait_next = curr_task->wait_prev = NULL;
+			spinlock_irqsave_unlock(&m->lock);
+			break;
+		}
+
+		block_current_task();
+		spinlock_irqsave_unlock(&m->lock);
+		reschedule();
+
+		// mutex_unlock() has removed us from the wait queue
+	}
+
+	m->owner = curr_task;
+	m->counter = 1;
+
+	return 0;
+}
+
+/** @brief Unlock mutex on exit of critical section
+ *
+ * The first task of the wait queue is woken up and competes
+ * with new callers of mutex_lock().
+ *
+ * @return
+ * - 0 on success
+ * - -EINVAL (-22) on failure
+ */
+inline static int mutex_unlock(mutex_t* m) {
+	task_t* task;
+
+	if (BUILTIN_EXPECT(!m, 0))
+		return -EINVAL;
+
+	m->counter--;
+	if (m->counter)
+		return 0;
+
+	m->owner = NULL;
+	// xchg is a full barrier => a task, which tests the mutex after its queuing, is visible
+	atomic_int32_test_and_set(&m->value, 0);
+
+	if (!m->first)
+		return 0;
+
+	spinlock_irqsave_lock(&m->lock);
+	task = m->first;
+	if (task) {
+		m->first = task->wait_next;
+		if (m->first)
+			m->first->wait_prev = NULL;
+		else
+			m->last = NULL;
+		task->wait_next = task->wait_prev = NULL;
+	}
+	spinlock_irqsave_unlock(&m->lock);
+
+	if (task)
+		wakeup_task(task->id);
+
+	return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2026
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the University nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file include/eduos/mutex_types.h
+ * @brief Mutex type definition
+ */
+
+#ifndef __MUTEX_TYPES_H__
+#define __MUTEX_TYPES_H__
+
+#include <eduos/spinlock_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct task;
+
+/** @brief Mutex structure
+ *
+ * A waiter spins as long as the owner is running. Afterwards,
+ * it is linked into the wait queue and blocks.
+ */
+typedef struct mutex {
+	/// 1 if the mutex is locked, 0 otherwise
+	atomic_int32_t value;
+	/// Task, which holds the mutex
+	struct task* owner;
+	/// Recursion counter of the owner
+	uint32_t counter;
+	/// First task in the wait queue
+	struct task* first;
+	/// Last task in the wait queue
+	struct task* last;
+	/// Protects the wait queue
+	spinlock_irqsave_t lock;
+} mutex_t;
+
+/// Macro for initialization of a mutex
+#define MUTEX_INIT {ATOMIC_INIT(0), NULL, 0, NULL, NULL, SPINLOCK_IRQSAVE_INIT}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
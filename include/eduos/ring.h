@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2026
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the University nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file include/eduos/ring.h
+ * @brief Layout of the system call ring
+ *
+ * A task submits several system calls through a page, which is shared
+ * between the task and the kernel, and hands them over with a single
+ * trap (__NR_ring_enter). The kernel stores the results in the
+ * completion queue of the same page.
+ *
+ * Keep this layout in sync with libgloss (include/sys/ring.h).
+ */
+
+#ifndef __RING_H__
+#define __RING_H__
+
+#include <eduos/stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Number of entries in each queue (power of two)
+#define RING_ENTRIES	32
+/// Mask to map a head or tail counter to an index
+#define RING_MASK	(RING_ENTRIES-1)
+
+/** @brief Submission queue entry: a system call and its arguments */
+typedef struct ring_sqe {
+	/// system call number
+	size_t nr;
+	/// arguments of the system call
+	size_t arg[5];
+	/// tag, which the kernel copies into the completion entry
+	size_t user_data;
+} ring_sqe_t;
+
+/** @brief Completion queue entry: the result of a submitted system call */
+typedef struct ring_cqe {
+	/// tag of the submission entry
+	size_t user_data;
+	/// return value of the system call
+	ssize_t res;
+} ring_cqe_t;
+
+/** @brief The shared page
+ *
+ * The task writes the submission entries and sq_tail, the kernel
+ * advances sq_head. The kernel writes the completion entries and
+ * cq_tail, the task advances cq_head. Head and tail are free running
+ * counters.
+ */
+typedef struct ring {
+	volatile uint32_t sq_head;
+	volatile uint32_t sq_tail;
+	volatile uint32_t cq_head;
+	volatile uint32_t cq_tail;
+	ring_sqe_t sqes[RING_ENTRIES];
+	ring_cqe_t cqes[RING_ENTRIES];
+} ring_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
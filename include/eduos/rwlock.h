@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2026
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the University nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file include/eduos/rwlock.h
+ * @brief Reader-writer lock
+ *
+ * Readers on different cores don't serialize. The writers are
+ * serialized by a mutex and wait until all readers have left.
+ * A writer is allowed to take the lock recursively and to take
+ * the read lock while it holds the write lock.
+ */
+
+#ifndef __RWLOCK_H__
+#define __RWLOCK_H__
+
+#include <eduos/stddef.h>
+#include <eduos/rwlock_types.h>
+#include <eduos/mutex.h>
+#include <eduos/errno.h>
+#include <asm/atomic.h>
+#include <asm/processor.h>
+#include <asm/irqflags.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Initialization of a reader-writer lock
+ *
+ * @param rw Pointer to the lock structure to initialize.
+ * @return
+ * - 0 on success
+ * - -EINVAL (-22) on failure
+ */
+inline static int rwlock_init(rwlock_t* rw) {
+	uint32_t i;
+
+	if (BUILTIN_EXPECT(!rw, 0))
+		return -EINVAL;
+
+	mutex_init(&rw->wlock);
+	atomic_int32_set(&rw->writer, 0);
+	for(i=0; i<MAX_CORES; i++)
+		atomic_int32_set(&rw->readers[i].count, 0);
+
+	return 0;
+}
+
+/** @brief Destroy reader-writer lock after use
+ * @return
+ * - 0 on success
+ * - -EINVAL (-22) on failure
+ */
+inline static int rwlock_destroy(rwlock_t* rw) {
+	if (BUILTIN_EXPECT(!rw, 0))
+		return -EINVAL;
+
+	return mutex_destroy(&rw->wlock);
+}
+
+/** @brief Enter a read-side critical section
+ * @return
+ * - 0 on success
+ * - -EINVAL (-22) on failure
+ */
+inline static int read_lock(rwlock_t* rw) {
+	atomic_int32_t* count;
+	uint8_t flags;
+
+	if (BUILTIN_EXPECT(!rw, 0))
+		return -EINVAL;
+
+	// the writer already excludes all other readers
+	if (rw->wlock.owner == per_core(current_task))
+		return 0;
+
+	while (1) {
+		flags = irq_nested_disable();
+		count = &rw->readers[CORE_ID].count;
+		// locked increment is a full barrier => a new writer sees us
+		atomic_int32_inc(count);
+		if (!atomic_int32_read(&rw->writer)) {
+			irq_nested_enable(flags);
+			return 0;
+		}
+
+		// give way to the writer
+		atomic_int32_dec(count);
+		irq_nested_enable(flags);
+
+		while (atomic_int32_read(&rw->writer))
+			PAUSE;
+	}
+}
+
+/** @brief Leave a read-side critical section
+ *
+ * The reader may run on another core as at read_lock(). Only the
+ * sum of all counters is meaningful.
+ *
+ * @return
+ * - 0 on success
+ * - -EINVAL (-22) on failure
+ */
+inline static int read_unlock(rwlock_t* rw) {
+	uint8_t flags;
+
+	if (BUILTIN_EXPECT(!rw, 0))
+		return -EINVAL;
+
+	if (rw->wlock.owner == per_core(current_task))
+		return 0;
+
+	flags = irq_nested_disable();
+	atomic_int32_dec(&rw->readers[CORE_ID].count);
+	irq_nested_enable(flags);
+
+	return 0;
+}
+
+/** @brief Enter a write-side critical section
+ * @return
+ * - 0 on success
+ * - -EINVAL (-22) on failure
+ */
+inline static int write_lock(rwlock_t* rw) {
+	int32_t readers;
+	uint32_t i;
+
+	if (BUILTIN_EXPECT(!rw, 0))
+		return -EINVAL;
+
+	mutex_lock(&rw->wlock);
+	if (rw->wlock.counter > 1)
+		return 0;
+
+	// block new readers (xchg is a full barrier)
+	atomic_int32_test_and_set(&rw->writer, 1);
+
+	// wait until all readers have left
+	do {
+		readers = 0;
+		for(i=0; i<MAX_CORES; i++)
+			readers += atomic_int32_read(&rw->readers[i].count);
+		if (readers)
+			PAUSE;
+	} while (readers);
+
+	return 0;
+}
+
+/** @brief Leave a write-side critical section
+ * @return
+ * - 0 on success
+ * - -EINVAL (-22) on failure
+ */
+inline static int write_unlock(rwlock_t* rw) {
+	if (BUILTIN_EXPECT(!rw, 0))
+		return -EINVAL;
+
+	if (rw->wlock.counter == 1)
+		atomic_int32_set(&rw->writer, 0);
+
+	return mutex_unlock(&rw->wlock);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2026
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the University nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file include/eduos/rwlock_types.h
+ * @brief Reader-writer lock type definition
+ */
+
+#ifndef __RWLOCK_TYPES_H__
+#define __RWLOCK_TYPES_H__
+
+#include <eduos/mutex_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Reader counter of a core
+ *
+ * Each counter occupies its own cache line. Hence, readers on
+ * different cores don't share a cache line. Locks, which are
+ * embedded in dynamically allocated structures, require an allocator
+ * which preserves the alignment (e.g. the slab caches).
+ */
+typedef struct {
+	/// Number of readers, which entered on this core
+	atomic_int32_t count;
+} __attribute__ ((aligned (CACHE_LINE))) rwlock_readers_t;
+
+/** @brief Reader-writer lock structure
+ *
+ * A reader only increments the counter of its core. A writer blocks
+ * new readers and waits until the sum of all counters is zero.
+ */
+typedef struct rwlock {
+	/// Serializes the writers
+	mutex_t wlock;
+	/// 1 if a writer holds or waits for the lock
+	atomic_int32_t writer;
+	/// Reader counters of the cores
+	rwlock_readers_t readers[MAX_CORES];
+} rwlock_t;
+
+/// Macro for initialization of a reader-writer lock
+#define RWLOCK_INIT {MUTEX_INIT, ATOMIC_INIT(0), {[0 ... MAX_CORES-1] = {ATOMIC_INIT(0)}}}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -39,6 +39,7 @@
 #include <eduos/semaphore_types.h>
 #include <eduos/spinlock.h>
 #include <eduos/errno.h>
+#include <eduos/time.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -56,15 +57,11 @@ extern "C" {
  * - -EINVAL on invalid argument
  */
 inline static int sem_init(sem_t* s, unsigned int v) {
-	unsigned int i;
-
 	if (BUILTIN_EXPECT(!s, 0))
 		return -EINVAL;
 
 	s->value = v;
-	s->pos = 0;
-	for(i=0; i<MAX_TASKS; i++)
-		s->queue[i] = MAX_TASKS;
+	s->first = s->last = NULL;
 	spinlock_irqsave_init(&s->lock);
 
 	return 0;
@@ -84,6 +81,45 @@ inline static int sem_destroy(sem_t* s) {
 	return 0;
 }
 
+/** @brief Append a task to the wait queue
+ *
+ * The caller has to hold the lock of the semaphore.
+ * A task, which is already queued, keeps its position.
+ */
+inline static void sem_enqueue(sem_t* s, task_t* task) {
+	if ((s->first == task) || task->wait_prev)
+		return;
+
+	task->wait_next = NULL;
+	task->wait_prev = s->last;
+	if (s->last)
+		s->last->wait_next = task;
+	else
+		s->first = task;
+	s->last = task;
+}
+
+/** @brief Remove a task from the wait queue
+ *
+ * The caller has to hold the lock of the semaphore.
+ */
+inline static void sem_dequeue(sem_t* s, task_t* task) {
+	if ((s->first != task) && !task->wait_prev)
+		return;
+
+	if (task->wait_prev)
+		task->wait_prev->wait_next = task->wait_next;
+	else
+		s->first = task->wait_next;
+
+	if (task->wait_next)
+		task->wait_next->wait_prev = task->wait_prev;
+	else
+		s->last = task->wait_prev;
+
+	task->wait_next = task->wait_prev = NULL;
+}
+
 /** @brief Nonblocking trywait for sempahore
  *
  * Will return immediately if not available
@@ -127,8 +163,7 @@ next_try1:
 		s->value--;
 		spinlock_irqsave_unlock(&s->lock);
 	} else {
-		s->queue[s->pos] = current_task->id;
-		s->pos = (s->pos + 1) % MAX_TASKS;
+		sem_enqueue(s, per_core(current_task));
 		block_current_task();
 		spinlock_irqsave_unlock(&s->lock);
 		reschedule();
@@ -138,6 +173,53 @@ next_try1:
 	return 0;
 }
 
+/** @brief Blocking wait for semaphore with a timeout
+ *
+ * @param s Address of the according sem_t structure
+ * @param ms Timeout in milliseconds
+ * @return
+ * - 0 on success
+ * - -EINVAL on invalid argument
+ * - -ETIME on timer expired
+ */
+inline static int sem_timedwait(sem_t* s, uint32_t ms) {
+	uint64_t deadline;
+	task_t* curr_task;
+
+	if (BUILTIN_EXPECT(!s, 0))
+		return -EINVAL;
+
+	deadline = get_clock_usec() + (uint64_t) ms * 1000;
+
+	curr_task = per_core(current_task);
+
+next_try2:
+	spinlock_irqsave_lock(&s->lock);
+	if (s->value > 0) {
+		s->value--;
+		/*
+		 * The timer may have woken us up, while sem_post() dequeued
+		 * another waiter. Then, we are still part of the queue.
+		 */
+		sem_dequeue(s, curr_task);
+		spinlock_irqsave_unlock(&s->lock);
+		return 0;
+	}
+
+	if (get_clock_usec() >= deadline) {
+		// the timer and not sem_post() has woken us up
+		sem_dequeue(s, curr_task);
+		spinlock_irqsave_unlock(&s->lock);
+		return -ETIME;
+	}
+
+	sem_enqueue(s, curr_task);
+	block_current_task_timeout(deadline);
+	spinlock_irqsave_unlock(&s->lock);
+	reschedule();
+	goto next_try2;
+}
+
 /** @brief Give back resource 
  * @return
  * - 0 on success
@@ -152,17 +234,12 @@ inline static int sem_post(sem_t* s) {
 		s->value++;
 		spinlock_irqsave_unlock(&s->lock);
 	} else {
-		unsigned int k, i;
+		task_t* task = s->first;
 
 		s->value++;
-		i = s->pos;
-		for(k=0; k<MAX_TASKS; k++) {
-			if (s->queue[i] < MAX_TASKS) {
-				wakeup_task(s->queue[i]);
-				s->queue[i] = MAX_TASKS;
-				break;
-			}
-			i = (i + 1) % MAX_TASKS;
+		if (task) {
+			sem_dequeue(s, task);
+			wakeup_task(task->id);
 		}
 		spinlock_irqsave_unlock(&s->lock);
 	}
@@ -40,20 +40,26 @@
 extern "C" {
 #endif
 
-/** @brief Semaphore structure */
+struct task;
+
+/** @brief Semaphore structure
+ *
+ * The waiting tasks are linked in FIFO order by
+ * their task structures (see wait_next and wait_prev).
+ */
 typedef struct {
 	/// Resource available count
 	unsigned int value;
-	/// Queue of waiting tasks
-	tid_t queue[MAX_TASKS];
-	/// Position in queue
-	unsigned int pos;
+	/// First task in the wait queue
+	struct task* first;
+	/// Last task in the wait queue
+	struct task* last;
 	/// Access lock
 	spinlock_irqsave_t lock;
 } sem_t;
 
 /// Macro for initialization of semaphore
-#define SEM_INIT(v) {v, {[0 ... MAX_TASKS-1] = MAX_TASKS}, 0, SPINLOCK_IRQSAVE_INIT}
+#define SEM_INIT(v) {v, NULL, NULL, SPINLOCK_IRQSAVE_INIT}
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2026
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the University nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file include/eduos/slab.h
+ * @brief Object caches
+ *
+ * A cache hands out objects of one fixed size. The objects are carved
+ * out of slabs, which are allocated by the buddy system. In contrast to
+ * kmalloc(), objects have no prefix and their size is not rounded up to
+ * a power of two. Each core keeps a small magazine of free objects,
+ * so that the common case neither takes a lock nor touches a slab.
+ */
+
+#ifndef __SLAB_H__
+#define __SLAB_H__
+
+#include <eduos/stddef.h>
+#include <eduos/mutex_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Number of objects in a per-core magazine (the magazine fills two cache lines)
+#define KMEM_MAGAZINE_SIZE	(2*CACHE_LINE/sizeof(void*) - 1)
+/// Minimal number of objects per slab
+#define KMEM_SLAB_OBJS		8
+
+struct kmem_cache;
+
+/** @brief Slab header
+ *
+ * A slab is a naturally aligned block of the buddy system. The header
+ * is located at the front. Therefore, the slab of an object is found
+ * by masking its address.
+ */
+typedef struct kmem_slab {
+	/// Next slab with free objects
+	struct kmem_slab* next;
+	/// Previous slab with free objects
+	struct kmem_slab* prev;
+	/// Cache, which owns this slab
+	struct kmem_cache* cache;
+	/// List of free objects within this slab
+	void* free;
+	/// Number of allocated objects
+	uint32_t inuse;
+} kmem_slab_t;
+
+/** @brief Per-core stack of free objects
+ *
+ * Aligned to cache lines to avoid false sharing between the cores.
+ */
+typedef struct kmem_magazine {
+	/// Number of objects in the magazine
+	size_t count;
+	/// Free objects
+	void* objs[KMEM_MAGAZINE_SIZE];
+} __attribute__ ((aligned (CACHE_LINE))) kmem_magazine_t;
+
+/** @brief Object cache */
+typedef struct kmem_cache {
+	/// Name of the cache (for debugging)
+	const char* name;
+	/// Object size (including alignment)
+	size_t size;
+	/// Binary size exponent of a slab (0 until the first slab is allocated)
+	uint32_t order;
+	/// Offset of the first object within a slab
+	uint32_t offset;
+	/// Number of slabs
+	uint32_t slabs;
+	/// Protects the slab list
+	mutex_t lock;
+	/// Slabs with free objects
+	kmem_slab_t* partial;
+	/// Magazines of the cores
+	kmem_magazine_t cpu[MAX_CORES];
+} kmem_cache_t;
+
+/// Macro for the static initialization of a cache for objects of size sz
+#define KMEM_CACHE_INIT(name, sz) {name, sz, 0, 0, 0, MUTEX_INIT, NULL, {[0 ... MAX_CORES-1] = {0, {NULL}}}}
+
+/** @brief Initialize a cache
+ *
+ * @param cache Pointer to the cache structure
+ * @param name Name of the cache
+ * @param size Size of an object
+ * @return
+ * - 0 on success
+ * - -EINVAL (-22) on failure
+ */
+int kmem_cache_init(kmem_cache_t* cache, const char* name, size_t size);
+
+/** @brief Allocate and initialize a new cache
+ *
+ * @param name Name of the cache
+ * @param size Size of an object
+ * @return Pointer to the new cache or NULL on failure
+ */
+kmem_cache_t* kmem_cache_create(const char* name, size_t size);
+
+/** @brief Release a cache, which was created by kmem_cache_create()
+ *
+ * All objects of the cache have to be freed before.
+ *
+ * @return
+ * - 0 on success
+ * - -EINVAL (-22) on failure
+ * - -EBUSY (-16) if the cache is still in use
+ */
+int kmem_cache_destroy(kmem_cache_t* cache);
+
+/** @brief Allocate an object
+ *
+ * @return Pointer to the object or NULL on failure
+ */
+void* kmem_cache_alloc(kmem_cache_t* cache);
+
+/** @brief Release an object, which was allocated by kmem_cache_alloc() */
+void kmem_cache_free(kmem_cache_t* cache, void* obj);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -93,7 +93,7 @@ inline static int spinlock_lock(spinlock_t* s) {
 	if (BUILTIN_EXPECT(!s, 0))
 		return -EINVAL;
 
-	if (s->owner == current_task->id) {
+	if (s->owner == per_core(current_task)->id) {
 		s->counter++;
 		return 0;
 	}
@@ -102,7 +102,7 @@ inline static int spinlock_lock(spinlock_t* s) {
 	while(atomic_int32_read(&s->dequeue) != ticket) {
 		PAUSE;
 	}
-	s->owner = current_task->id;
+	s->owner = per_core(current_task)->id;
 	s->counter = 1;
 
 	return 0;
@@ -141,6 +141,7 @@ inline static int spinlock_irqsave_init(spinlock_irqsave_t* s) {
 	atomic_int32_set(&s->queue, 0);
 	atomic_int32_set(&s->dequeue, 1);
 	s->flags = 0;
+	s->coreid = MAX_CORES;
 	s->counter = 0;
 
 	return 0;
@@ -156,6 +157,7 @@ inline static int spinlock_irqsave_destroy(spinlock_irqsave_t* s) {
 		return -EINVAL;
 
 	s->flags = 0;
+	s->coreid = MAX_CORES;
 	s->counter = 0;
 
 	return 0;
@@ -174,16 +176,18 @@ inline static int spinlock_irqsave_lock(spinlock_irqsave_t* s) {
 		return -EINVAL;
 
 	flags = irq_nested_disable();
-	if (s->counter == 1) {
+	if (s->coreid == CORE_ID) {
 		s->counter++;
 		return 0;
 	}
 
 	ticket = atomic_int32_add(&s->queue, 1);
 	while (atomic_int32_read(&s->dequeue) != ticket) {
+		tlb_shootdown_poll();
 		PAUSE;
 	}
 
+	s->coreid = CORE_ID;
 	s->flags = flags;
 	s->counter = 1;
 
@@ -205,7 +209,8 @@ inline static int spinlock_irqsave_unlock(spinlock_irqsave_t* s) {
 	if (!s->counter) {
 		flags = s->flags;
 		s->flags = 0;
-                atomic_int32_inc(&s->dequeue);
+		s->coreid = MAX_CORES;
+		atomic_int32_inc(&s->dequeue);
 		irq_nested_enable(flags);
 	}
 
@@ -36,6 +36,7 @@
 
 #include <eduos/config.h>
 #include <asm/stddef.h>
+#include <asm/irqflags.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -46,9 +47,65 @@ extern "C" {
 /// represents a task identifier
 typedef unsigned int tid_t;
 
+#if MAX_CORES == 1
+#define per_core(name) name
+#define set_per_core(name, value) do { name = (value); } while (0)
+#define DECLARE_PER_CORE(type, name) extern type name;
+#define DEFINE_PER_CORE(type, name, def_value) type name = def_value;
+#define DEFINE_PER_CORE_STATIC(type, name, def_value) static type name = def_value;
+#define CORE_ID 0
+#else
+/** @brief Determine the logical id of the current core
+ *
+ * The boot processor is always core 0.
+ */
+uint32_t smp_id(void);
+
+/*
+ * The value is read while interrupts are disabled. A pointer to the
+ * variable would refer to the wrong core, if the task is migrated
+ * before it dereferences the pointer.
+ */
+#define per_core(name) __get_percore_##name()
+#define set_per_core(name, value) __set_percore_##name(value)
+#define DECLARE_PER_CORE(type, name) \
+	typedef struct { type var  __attribute__ ((aligned (CACHE_LINE))); } aligned_##name;\
+	extern aligned_##name name[MAX_CORES];\
+	inline static type __get_percore_##name(void) {\
+		type ret; \
+		uint8_t flags = irq_nested_disable(); \
+		ret = name[smp_id()].var; \
+		irq_nested_enable(flags);\
+		return ret; \
+	}\
+	inline static void __set_percore_##name(type value) {\
+		uint8_t flags = irq_nested_disable(); \
+		name[smp_id()].var = value; \
+		irq_nested_enable(flags);\
+	}
+#define DEFINE_PER_CORE(type, name, def_value) \
+	aligned_##name name[MAX_CORES] = {[0 ... MAX_CORES-1] = {def_value}};
+#define DEFINE_PER_CORE_STATIC(type, name, def_value) \
+	typedef struct { type var  __attribute__ ((aligned (CACHE_LINE))); } aligned_##name;\
+	static aligned_##name name[MAX_CORES] = {[0 ... MAX_CORES-1] = {def_value}}; \
+	inline static type __get_percore_##name(void) {\
+		type ret; \
+		uint8_t flags = irq_nested_disable(); \
+		ret = name[smp_id()].var; \
+		irq_nested_enable(flags);\
+		return ret; \
+	}\
+	inline static void __set_percore_##name(type value) {\
+		uint8_t flags = irq_nested_disable(); \
+		name[smp_id()].var = value; \
+		irq_nested_enable(flags);\
+	}
+#define CORE_ID smp_id()
+#endif
+
 struct task;
 /// pointer to the current (running) task
-extern struct task* current_task;
+DECLARE_PER_CORE(struct task*, current_task);
 
 #ifdef __cplusplus
 }
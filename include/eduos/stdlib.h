@@ -83,9 +83,13 @@ void kfree(void* addr);
 
 /** @brief Create a new stack for a new task
  *
- * @return start address of the new stack
+ * The stack is mapped into the kernel space and is guarded by an
+ * unmapped page below its lowest address.
+ *
+ * @param sz Size of the stack in bytes
+ * @return start address of the new stack or NULL on failure
  */
-void* create_stack(tid_t id);
+void* create_stack(size_t sz);
 
 /** @brief String to long
  *
@@ -75,6 +75,8 @@ extern "C" {
 #define __NR_stat		30
 #define __NR_dup		31
 #define __NR_dup2		32
+#define __NR_ring_setup		33
+#define __NR_ring_enter		34
 
 #ifdef __cplusplus
 }
@@ -81,6 +81,20 @@ int multitasking_init(void);
  */
 int create_kernel_task(tid_t* id, entry_point_t ep, void* args, uint8_t prio);
 
+/** @brief create a kernel-level task on a specific core.
+ *
+ * @param id The value behind this pointer will be set to the new task's id
+ * @param ep Pointer to the entry function for the new task
+ * @param args Arguments the task shall start with
+ * @param prio Desired priority of the new kernel task
+ * @param core_id Start the new task on the core with this id
+ *
+ * @return
+ * - 0 on success
+ * - -EINVAL (-22) on failure
+ */
+int create_kernel_task_on_core(tid_t* id, entry_point_t ep, void* args, uint8_t prio, uint32_t core_id);
+
 /** @brief Create a user level task.
  *
  * @param id The value behind this pointer will be set to the new task's id
@@ -93,9 +107,20 @@ int create_kernel_task(tid_t* id, entry_point_t ep, void* args, uint8_t prio);
  */
 int create_user_task(tid_t* id, const char* fame, char** argv);
 
-/** @brief Create a task with a specific entry point
+/** @brief Create a user level task on a specific core.
+ *
+ * @param id The value behind this pointer will be set to the new task's id
+ * @param fname Filename of the executable to start the task with
+ * @param argv Pointer to arguments array
+ * @param core_id Start the new task on the core with this id
  *
- * @todo Don't acquire table_lock for the whole task creation.
+ * @return
+ * - 0 on success
+ * - -EINVAL (-22) or -ENOMEM (-12)on failure
+ */
+int create_user_task_on_core(tid_t* id, const char* fame, char** argv, uint32_t core_id);
+
+/** @brief Create a task with a specific entry point
  *
  * @param id Pointer to a tid_t struct were the id shall be set
  * @param ep Pointer to the function the task shall start with
@@ -107,7 +132,26 @@ int create_user_task(tid_t* id, const char* fame, char** argv);
  * - 0 on success
  * - -ENOMEM (-12) or -EINVAL (-22) on failure
  */
-int create_task(tid_t* id, entry_point_t ep, void* arg, uint8_t prio);
+int create_task(tid_t* id, entry_point_t ep, void* arg, uint8_t prio, uint32_t core_id);
+
+/** @brief Determine the online core with the lowest load
+ *
+ * New tasks are placed on this core, if no core is specified.
+ *
+ * @return The id of the core
+ */
+uint32_t get_next_core_id(void);
+
+/** @brief Initialize the idle task of an application processor
+ *
+ * The calling core uses the boot stack as stack of its idle task
+ * and starts to use its own ready queue.
+ *
+ * @return
+ * - 0 on success
+ * - -ENOMEM (-12) or -EINVAL (-22) on failure
+ */
+int set_idle_task(void);
 
 /** @brief Cleanup function for the task termination
  *
@@ -149,6 +193,18 @@ int wakeup_task(tid_t);
  */
 int block_current_task(void);
 
+/** @brief Block current task until a deadline
+ *
+ * The current task's status will be changed to TASK_BLOCKED. The task
+ * is woken up by wakeup_task() or at the latest after the deadline.
+ *
+ * @param deadline Wakeup time in microseconds (see get_clock_usec())
+ * @return
+ * - 0 on success
+ * - -EINVAL (-22) on failure
+ */
+int block_current_task_timeout(uint64_t deadline);
+
 /** @brief Abort current task */
 void NORETURN abort(void);
 
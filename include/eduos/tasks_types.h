@@ -39,7 +39,9 @@
 
 #include <eduos/stddef.h>
 #include <eduos/spinlock_types.h>
+#include <eduos/rwlock_types.h>
 #include <eduos/vma.h>
+#include <eduos/time.h>
 #include <asm/tasks_types.h>
 #include <asm/atomic.h>
 
@@ -67,6 +69,21 @@ extern "C" {
 
 typedef int (*entry_point_t)(void*);
 
+/** @brief Demand paging statistics of a task */
+typedef struct {
+	/// number of page faults on the heap
+	uint32_t		heap_faults;
+	/// number of pages, which were mapped ahead by fault-around
+	uint32_t		saved_faults;
+	/// current fault-around window in pages (0 => not yet used)
+	uint32_t		window;
+	/// clock tick of the last heap fault
+	uint64_t		last_tick;
+} fault_stats_t;
+
+struct fildes;
+struct ring;
+
 /** @brief Represents a the process control block */
 typedef struct task {
 	/// Task id = position in the task table
@@ -81,12 +98,16 @@ typedef struct task {
 	uint8_t			flags;
 	/// Task priority
 	uint8_t			prio;
+	/// ID of the core which currently executes the task
+	uint32_t		last_core;
 	/// Physical address of root page table
 	size_t			page_map;
+	/// Cores, which may hold valid TLB entries of the task (tagged by its PCID)
+	uint32_t		tlb_cores;
 	/// Lock for page tables
 	spinlock_irqsave_t	page_lock;
 	/// lock for the VMA_list
-	spinlock_t		vma_lock;
+	rwlock_t		vma_lock;
 	/// list of VMAs
 	vma_t*			vma_list;
 	/// the userspace heap
@@ -97,6 +118,18 @@ typedef struct task {
 	struct task*	next;
 	/// previous task in the queue
 	struct task*	prev;
+	/// next task in the wait queue of a semaphore
+	struct task*	wait_next;
+	/// previous task in the wait queue of a semaphore
+	struct task*	wait_prev;
+	/// wakes up the task after a timeout
+	ktimer_t		timer;
+	/// demand paging statistics
+	fault_stats_t	faults;
+	/// file descriptor table (NR_OPEN entries, allocated by the first open)
+	struct fildes**	fildes_table;
+	/// system call ring, which is shared with the task (see ring.h)
+	struct ring*	ring;
 	/// FPU state
 	union fpu_state	fpu;
 } task_t;
@@ -106,7 +139,7 @@ typedef struct {
         task_t* last;
 } task_list_t;
 
-/** @brief Represents a queue for all runable tasks */
+/** @brief Represents a queue for all runable tasks of a core */
 typedef struct {
 	/// idle task
 	task_t*		idle __attribute__ ((aligned (CACHE_LINE)));
@@ -34,10 +34,64 @@
 #ifndef __TIME_H__
 #define __TIME_H__
 
+#include <eduos/stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/// Length of a time slice in microseconds
+#define TIMESLICE_USEC	(1000000 / TIMER_FREQ)
+
+/** @brief Clock page, which is mapped read-only into each user task
+ *
+ * A task reads the uptime without a system call: as long as seq is odd,
+ * the kernel updates the page. The uptime in microseconds is
+ * ticks * (1000000 / hz) + (rdtsc() - tsc) / freq.
+ *
+ * Keep this layout in sync with libgloss (vclock.h).
+ */
+typedef struct vclock {
+	/// sequence counter, odd during an update
+	volatile uint32_t seq;
+	/// TSC frequency in MHz or 0, as long as the periodic timer is used
+	uint32_t freq;
+	/// number of timer ticks
+	uint64_t ticks;
+	/// TSC value at the last tick
+	uint64_t tsc;
+	/// number of ticks per second
+	uint32_t hz;
+} vclock_t;
+
+/// Address of the clock page in each user task (below the reserved top level entries)
+#define VCLOCK_ADDR	(VMA_USER_MAX - PAGE_SIZE)
+
+/// Callback of a timer
+typedef void (*timer_func_t)(void* arg);
+
+/** @brief One-shot timer
+ *
+ * An active timer is part of the timer wheel of a core.
+ */
+typedef struct ktimer {
+	/// Expiration time in microseconds (see get_clock_usec())
+	uint64_t deadline;
+	/// Function, which is called in interrupt context after expiration
+	timer_func_t func;
+	/// Argument of the callback
+	void* arg;
+	/// Core, which owns the timer, or MAX_CORES if the timer is inactive
+	uint32_t core;
+	/// Next timer in the slot of the timer wheel
+	struct ktimer* next;
+	/// Previous timer in the slot of the timer wheel
+	struct ktimer* prev;
+} ktimer_t;
+
+/// Static initializer of an inactive timer
+#define KTIMER_INIT(f, a)	{0, f, a, MAX_CORES, NULL, NULL}
+
 /** @brief Initialize Timer interrupts 
  *
  * This procedure installs IRQ handlers for timer interrupts
@@ -49,6 +103,85 @@ int timer_init(void);
  */
 uint64_t get_clock_tick(void);
 
+/** @brief Returns the uptime of the system in microseconds
+ *
+ * In the one-shot mode, the time stamp counter is used as time base.
+ * Otherwise, the resolution is limited to one tick.
+ */
+uint64_t get_clock_usec(void);
+
+/** @brief Switch from the periodic timer to one-shot timers
+ *
+ * Called by the APIC driver, after the APIC timer is calibrated. Afterwards,
+ * a core is only interrupted, if a timer expires or if its time slice ends.
+ */
+void timer_oneshot_init(void);
+
+/** @brief Map the clock page into the current task
+ *
+ * @return
+ * - 0 on success
+ * - <0 on failure
+ */
+int vclock_map(void);
+
+/** @brief Remove the clock page from the current task
+ *
+ * The page frame belongs to the kernel. Hence, the mapping has to be
+ * removed before page_map_drop() releases the user space.
+ */
+void vclock_unmap(void);
+
+/** @brief Initialize an inactive timer
+ *
+ * @param timer Pointer to the timer
+ * @param func Callback, which is called after expiration
+ * @param arg Argument of the callback
+ */
+void timer_setup(ktimer_t* timer, timer_func_t func, void* arg);
+
+/** @brief Activate a timer on the current core
+ *
+ * @param timer Pointer to an inactive timer
+ * @param deadline Expiration time in microseconds (see get_clock_usec())
+ * @return
+ * - 0 on success
+ * - -EINVAL (-22) if the timer is already active
+ */
+int timer_add(ktimer_t* timer, uint64_t deadline);
+
+/** @brief Deactivate a timer
+ *
+ * Afterwards, the callback of the timer doesn't run on another core.
+ *
+ * @param timer Pointer to the timer
+ * @return
+ * - 0 on success
+ * - -EINVAL (-22) if the timer isn't active (e.g. already expired)
+ */
+int timer_del(ktimer_t* timer);
+
+/** @brief Program the next timer interrupt of the current core
+ *
+ * The next interrupt is the earliest deadline of the core's timer wheel.
+ * If the core doesn't run its idle task, the interrupt occurs at
+ * the latest at the end of the current time slice.
+ */
+void timer_reprogram(void);
+
+/** @brief Blocks the current task for the given number of ticks
+ *
+ * @param ticks Number of ticks to wait
+ * @return 0 on success
+ */
+int timer_wait(unsigned int ticks);
+
+/** @brief Blocks the current task for the given number of seconds
+ *
+ * @param sec Number of seconds to wait
+ */
+static inline void sleep(unsigned int sec) { timer_wait(sec*TIMER_FREQ); }
+
 #ifdef __cplusplus
 }
 #endif
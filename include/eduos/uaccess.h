@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2026
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the University nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * @file include/eduos/uaccess.h
+ * @brief Access to buffers of the user space
+ *
+ * Kernel and user space share one address space. Nevertheless, the kernel
+ * accesses user buffers only by the copy routines after validating them
+ * against the VMAs of the current task. Faults, which the page fault
+ * handler isn't able to resolve, abort the copy routines instead of
+ * halting the kernel.
+ */
+
+#ifndef __UACCESS_H__
+#define __UACCESS_H__
+
+#include <eduos/stddef.h>
+#include <eduos/vma.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Size of the kernel buffers, through which system calls copy user buffers
+#define UACCESS_CHUNK	512
+
+/** @brief Check if the current task is allowed to access a user buffer
+ *
+ * @param addr Start address of the buffer
+ * @param len Length of the buffer in bytes
+ * @param flags VMA_READ and/or VMA_WRITE
+ * @return
+ * - 0 if the whole buffer is covered by user VMAs with the requested rights
+ * - -EFAULT (-14) on failure
+ */
+int access_user(const void* addr, size_t len, uint32_t flags);
+
+/** @brief Copy a buffer from the user space
+ *
+ * @param dest Destination buffer in the kernel
+ * @param src Source buffer in the user space
+ * @param n Number of bytes to copy
+ * @return Number of bytes, which aren't copied
+ */
+size_t copy_from_user(void* dest, const void* src, size_t n);
+
+/** @brief Copy a buffer to the user space
+ *
+ * @param dest Destination buffer in the user space
+ * @param src Source buffer in the kernel
+ * @param n Number of bytes to copy
+ * @return Number of bytes, which aren't copied
+ */
+size_t copy_to_user(void* dest, const void* src, size_t n);
+
+/** @brief Copy a null-terminated string from the user space
+ *
+ * @param dest Destination buffer in the kernel
+ * @param src String in the user space
+ * @param n Size of the destination buffer
+ * @return
+ * - the length of the string on success
+ * - -EFAULT (-14) if src isn't accessible
+ * - -ENAMETOOLONG (-91) if the string doesn't fit into dest
+ */
+ssize_t strncpy_from_user(char* dest, const char* src, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
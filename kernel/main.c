@@ -136,6 +136,25 @@ static int eduos_init(void)
 	return 0;
 }
 
+#if MAX_CORES > 1
+/*
+ * The application processors enter this idle loop after
+ * their initialization.
+ */
+int smp_main(void)
+{
+	irq_enable();
+
+	while(1) {
+		// use the idle time to prepare zeroed page frames
+		if (!zero_pool_fill())
+			HALT;
+	}
+
+	return 0;
+}
+#endif
+
 int main(void)
 {
 	char* argv1[] = {"/bin/hello", NULL};
@@ -166,8 +185,10 @@ int main(void)
 	// x64: wrapper maps function to user space to start a user-space task
 	//create_kernel_task(NULL, wrapper, "userfoo", NORMAL_PRIO);
 
-	while(1) { 
-		HALT;
+	while(1) {
+		// use the idle time to prepare zeroed page frames
+		if (!zero_pool_fill())
+			HALT;
 	}
 
 	return 0;
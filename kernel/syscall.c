@@ -30,27 +30,215 @@
 #include <eduos/tasks.h>
 #include <eduos/errno.h>
 #include <eduos/syscall.h>
+#include <eduos/stdlib.h>
+#include <eduos/string.h>
 #include <eduos/spinlock.h>
+#include <eduos/rwlock.h>
+#include <eduos/fs.h>
+#include <eduos/uaccess.h>
+#include <eduos/memory.h>
+#include <eduos/vma.h>
+#include <eduos/ring.h>
+#include <asm/page.h>
 
-static int sys_write(int fd, const char* buf, size_t len)
+/// File descriptors below this number are reserved for stdin, stdout and stderr
+#define FD_FIRST	3
+
+/** @brief Look up an open file of the current task
+ * @return
+ * - the file descriptor structure
+ * - NULL if fd isn't open
+ */
+static fildes_t* fd_lookup(int fd)
 {
-	//TODO: Currently, we ignore the file descriptor
+	task_t* task = per_core(current_task);
 
-	if (BUILTIN_EXPECT(!buf, 0))
-		return -1;
+	if (BUILTIN_EXPECT((fd < 0) || (fd >= NR_OPEN) || !task->fildes_table, 0))
+		return NULL;
+
+	return task->fildes_table[fd];
+}
+
+static int sys_open(const char* name, int flags, int mode)
+{
+	task_t* task = per_core(current_task);
+	fildes_t* file;
+	char fname[MAX_FNAME];
+	int fd, ret;
+
+	if (BUILTIN_EXPECT(!name, 0))
+		return -EINVAL;
+
+	// the path is the only buffer, which the kernel copies
+	ret = strncpy_from_user(fname, name, MAX_FNAME);
+	if (BUILTIN_EXPECT(ret < 0, 0))
+		return ret;
+
+	// the table is allocated by the first open
+	if (!task->fildes_table) {
+		task->fildes_table = kmalloc(NR_OPEN * sizeof(fildes_t*));
+		if (BUILTIN_EXPECT(!task->fildes_table, 0))
+			return -ENOMEM;
+		memset(task->fildes_table, 0x00, NR_OPEN * sizeof(fildes_t*));
+	}
+
+	for (fd=FD_FIRST; (fd < NR_OPEN) && task->fildes_table[fd]; fd++)
+		;
+	if (BUILTIN_EXPECT(fd >= NR_OPEN, 0))
+		return -EMFILE;
+
+	file = kmem_cache_alloc(&fildes_cache);
+	if (BUILTIN_EXPECT(!file, 0))
+		return -ENOMEM;
+
+	file->node = NULL;
+	file->offset = 0;
+	file->flags = flags;
+	file->mode = mode;
+	file->count = 1;
+
+	ret = open_fs(file, fname);
+	if (BUILTIN_EXPECT((ret < 0) || !file->node, 0)) {
+		kmem_cache_free(&fildes_cache, file);
+		return ret < 0 ? ret : -ENOENT;
+	}
 
-	kputs(buf);
+	task->fildes_table[fd] = file;
+
+	return fd;
+}
+
+static int sys_close(int fd)
+{
+	fildes_t* file = fd_lookup(fd);
+
+	if (!file)
+		return (fd >= 0) && (fd < FD_FIRST) ? 0 : -EBADF;
+
+	per_core(current_task)->fildes_table[fd] = NULL;
+	if (!--file->count) {
+		// the initrd has no close callback => ignore the result
+		close_fs(file);
+		kmem_cache_free(&fildes_cache, file);
+	}
 
 	return 0;
 }
 
+static ssize_t sys_read(int fd, char* buf, size_t len)
+{
+	fildes_t* file = fd_lookup(fd);
+	uint8_t bounce[UACCESS_CHUNK];
+	size_t chunk, done = 0;
+	ssize_t ret;
+
+	if (BUILTIN_EXPECT(!buf, 0))
+		return -EINVAL;
+	if (BUILTIN_EXPECT(access_user(buf, len, VMA_WRITE), 0))
+		return -EFAULT;
+
+	// there is no console input
+	if (!file)
+		return (fd >= 0) && (fd < FD_FIRST) ? 0 : -EBADF;
+
+	// the file system never touches the user buffer => copy it in chunks
+	while (done < len) {
+		chunk = (len - done < UACCESS_CHUNK) ? len - done : UACCESS_CHUNK;
+
+		ret = read_fs(file, bounce, chunk);
+		if (ret <= 0)
+			return done ? (ssize_t) done : ret;
+		if (BUILTIN_EXPECT(copy_to_user(buf + done, bounce, ret), 0))
+			return -EFAULT;
+
+		done += ret;
+		if ((size_t) ret < chunk)
+			break;
+	}
+
+	return done;
+}
+
+static ssize_t sys_write(int fd, const char* buf, size_t len)
+{
+	fildes_t* file = fd_lookup(fd);
+	uint8_t bounce[UACCESS_CHUNK];
+	size_t i, chunk, done = 0;
+	ssize_t ret;
+
+	if (BUILTIN_EXPECT(!buf, 0))
+		return -EINVAL;
+	if (BUILTIN_EXPECT(access_user(buf, len, VMA_READ), 0))
+		return -EFAULT;
+
+	// stdout and stderr are the console
+	if (!file && (fd != 1) && (fd != 2))
+		return -EBADF;
+
+	while (done < len) {
+		chunk = (len - done < UACCESS_CHUNK) ? len - done : UACCESS_CHUNK;
+
+		if (BUILTIN_EXPECT(copy_from_user(bounce, buf + done, chunk), 0))
+			return -EFAULT;
+
+		if (!file) {
+			for (i=0; i<chunk; i++)
+				kputchar(bounce[i]);
+			ret = chunk;
+		} else {
+			ret = write_fs(file, bounce, chunk);
+			if (ret <= 0)
+				return done ? (ssize_t) done : ret;
+		}
+
+		done += ret;
+		if ((size_t) ret < chunk)
+			break;
+	}
+
+	return done;
+}
+
+static off_t sys_lseek(int fd, off_t offset, int whence)
+{
+	fildes_t* file = fd_lookup(fd);
+
+	if (BUILTIN_EXPECT(!file, 0))
+		return (fd >= 0) && (fd < FD_FIRST) ? -ESPIPE : -EBADF;
+	if (BUILTIN_EXPECT(file->node->type != FS_FILE, 0))
+		return -ESPIPE;
+
+	switch(whence)
+	{
+	case SEEK_SET:
+		break;
+	case SEEK_CUR:
+		offset += file->offset;
+		break;
+	case SEEK_END:
+		// the initrd keeps the file size as block size
+		offset += file->node->block_size;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	// the initrd doesn't support holes behind the end of a file
+	if (BUILTIN_EXPECT((offset < 0) || ((size_t) offset > file->node->block_size), 0))
+		return -EINVAL;
+
+	file->offset = offset;
+
+	return offset;
+}
+
 static ssize_t sys_sbrk(int incr)
 {
-	task_t* task = current_task;
+	task_t* task = per_core(current_task);
 	vma_t* heap = task->heap;
 	ssize_t ret;
 
-	spinlock_lock(&task->vma_lock);
+	write_lock(&task->vma_lock);
 
 	if (BUILTIN_EXPECT(!heap, 0)) {
 		kprintf("sys_sbrk: missing heap!\n");
@@ -65,49 +253,188 @@ static ssize_t sys_sbrk(int incr)
 	// allocation and mapping of new pages for the heap
 	// is catched by the pagefault handler
 
-	spinlock_unlock(&task->vma_lock);
+	write_unlock(&task->vma_lock);
 
 	return ret;
 }
 
-ssize_t syscall_handler(uint32_t sys_nr, ...)
+ssize_t syscall_handler(size_t sys_nr, size_t arg0, size_t arg1, size_t arg2, size_t arg3, size_t arg4);
+
+static int sys_ring_setup(ring_t** addr)
 {
-	ssize_t ret = -EINVAL;
-	va_list vl;
+	task_t* task = per_core(current_task);
+	size_t npages = PAGE_FLOOR(sizeof(ring_t)) >> PAGE_BITS;
+	size_t viraddr, phyaddr, bits;
 
-	va_start(vl, sys_nr);
+	// each task owns a single ring
+	if (task->ring)
+		goto out;
 
-	switch(sys_nr)
-	{
-	case __NR_exit:
-		sys_exit(va_arg(vl, uint32_t));
-		ret = 0;
-		break;
-	case __NR_write: {
-		int fd = va_arg(vl, int);
-		const char* buf = va_arg(vl, const char*);
-		size_t len = va_arg(vl, size_t);
-		ret = sys_write(fd, buf, len);
-		break;
+	viraddr = vma_alloc(npages*PAGE_SIZE, VMA_USER|VMA_READ|VMA_WRITE|VMA_CACHEABLE);
+	if (BUILTIN_EXPECT(!viraddr, 0))
+		return -ENOMEM;
+
+	phyaddr = get_pages(npages);
+	if (BUILTIN_EXPECT(!phyaddr, 0)) {
+		vma_free(viraddr, viraddr + npages*PAGE_SIZE);
+		return -ENOMEM;
 	}
-	//TODO: Currently, we ignore file descriptors
-	case __NR_open:
-	case __NR_close:
-		ret = 0;
-		break;
-	case __NR_sbrk: {
-		int incr = va_arg(vl, int);
 
-		ret = sys_sbrk(incr);
-		break;
+	bits = PG_USER|PG_RW;
+#ifdef CONFIG_X86_64
+	if (has_nx())
+		bits |= PG_XD;
+#endif
+	if (BUILTIN_EXPECT(page_map(viraddr, phyaddr, npages, bits), 0)) {
+		vma_free(viraddr, viraddr + npages*PAGE_SIZE);
+		put_pages(phyaddr, npages);
+		return -ENOMEM;
 	}
-	default:
-		kprintf("invalid system call: %u\n", sys_nr);
-		ret = -ENOSYS;
-		break;
-	};
 
-	va_end(vl);
+	memset((void*) viraddr, 0x00, npages*PAGE_SIZE);
+	task->ring = (ring_t*) viraddr;
 
-	return ret;
+out:
+	// the address doesn't fit into the return value on 32 bit systems
+	if (BUILTIN_EXPECT(copy_to_user(addr, &task->ring, sizeof(ring_t*)), 0))
+		return -EFAULT;
+
+	return 0;
+}
+
+static ssize_t sys_ring_enter(uint32_t to_submit)
+{
+	ring_t* ring = per_core(current_task)->ring;
+	uint32_t head, tail, cq_head, cq_tail, count;
+	ring_sqe_t sqe;
+	ring_cqe_t* cqe;
+
+	if (BUILTIN_EXPECT(!ring, 0))
+		return -EINVAL;
+
+	/*
+	 * The task owns sq_tail and cq_head and is able to modify them at
+	 * any time. Hence, we read them only once and trust only the
+	 * snapshot. sq_head and cq_tail are only written by the kernel.
+	 */
+	head = ring->sq_head;
+	tail = atomic_load_acquire(&ring->sq_tail);
+	cq_head = atomic_load_acquire(&ring->cq_head);
+	cq_tail = ring->cq_tail;
+
+	if (BUILTIN_EXPECT(tail - head > RING_ENTRIES, 0))
+		return -EINVAL;
+	if (to_submit > tail - head)
+		to_submit = tail - head;
+
+	// stop, if the completion queue is full
+	if (BUILTIN_EXPECT(cq_tail - cq_head > RING_ENTRIES, 0))
+		return -EINVAL;
+	if (to_submit > RING_ENTRIES - (cq_tail - cq_head))
+		to_submit = RING_ENTRIES - (cq_tail - cq_head);
+
+	for (count=0; count<to_submit; count++, head++, cq_tail++) {
+		// the task is able to modify the entry while we're using it
+		memcpy(&sqe, (void*) (ring->sqes + (head & RING_MASK)), sizeof(ring_sqe_t));
+
+		cqe = ring->cqes + (cq_tail & RING_MASK);
+		cqe->user_data = sqe.user_data;
+		switch(sqe.nr)
+		{
+		case __NR_exit:
+		case __NR_ring_setup:
+		case __NR_ring_enter:
+			cqe->res = -EINVAL;
+			break;
+		default:
+			cqe->res = syscall_handler(sqe.nr, sqe.arg[0], sqe.arg[1], sqe.arg[2], sqe.arg[3], sqe.arg[4]);
+		}
+	}
+
+	// the completion entries have to be visible before the new tail
+	wmb();
+	atomic_store_release(&ring->sq_head, head);
+	atomic_store_release(&ring->cq_tail, cq_tail);
+
+	return count;
+}
+
+/** @brief Signature of the entries in the system call table
+ *
+ * All system calls take the same number of register-sized arguments.
+ * Unused arguments are ignored.
+ */
+typedef ssize_t (*syscall_t)(size_t arg0, size_t arg1, size_t arg2, size_t arg3, size_t arg4);
+
+static ssize_t syscall_exit(size_t arg0, size_t arg1, size_t arg2, size_t arg3, size_t arg4)
+{
+	sys_exit((int) arg0);
+
+	return 0;
+}
+
+static ssize_t syscall_write(size_t arg0, size_t arg1, size_t arg2, size_t arg3, size_t arg4)
+{
+	return sys_write((int) arg0, (const char*) arg1, arg2);
+}
+
+static ssize_t syscall_open(size_t arg0, size_t arg1, size_t arg2, size_t arg3, size_t arg4)
+{
+	return sys_open((const char*) arg0, (int) arg1, (int) arg2);
+}
+
+static ssize_t syscall_close(size_t arg0, size_t arg1, size_t arg2, size_t arg3, size_t arg4)
+{
+	return sys_close((int) arg0);
+}
+
+static ssize_t syscall_read(size_t arg0, size_t arg1, size_t arg2, size_t arg3, size_t arg4)
+{
+	return sys_read((int) arg0, (char*) arg1, arg2);
+}
+
+static ssize_t syscall_lseek(size_t arg0, size_t arg1, size_t arg2, size_t arg3, size_t arg4)
+{
+	return sys_lseek((int) arg0, (off_t) (ssize_t) arg1, (int) arg2);
+}
+
+static ssize_t syscall_sbrk(size_t arg0, size_t arg1, size_t arg2, size_t arg3, size_t arg4)
+{
+	return sys_sbrk((int) arg0);
+}
+
+static ssize_t syscall_ring_setup(size_t arg0, size_t arg1, size_t arg2, size_t arg3, size_t arg4)
+{
+	return sys_ring_setup((ring_t**) arg0);
+}
+
+static ssize_t syscall_ring_enter(size_t arg0, size_t arg1, size_t arg2, size_t arg3, size_t arg4)
+{
+	return sys_ring_enter((uint32_t) arg0);
+}
+
+/// System call table, indexed by the system call number
+static const syscall_t syscall_table[] = {
+	[__NR_exit]	= syscall_exit,
+	[__NR_write]	= syscall_write,
+	[__NR_open]	= syscall_open,
+	[__NR_close]	= syscall_close,
+	[__NR_read]	= syscall_read,
+	[__NR_lseek]	= syscall_lseek,
+	[__NR_sbrk]	= syscall_sbrk,
+	[__NR_ring_setup]	= syscall_ring_setup,
+	[__NR_ring_enter]	= syscall_ring_enter
+};
+
+/// Number of entries in the system call table
+#define NR_SYSCALLS	(sizeof(syscall_table) / sizeof(syscall_t))
+
+ssize_t syscall_handler(size_t sys_nr, size_t arg0, size_t arg1, size_t arg2, size_t arg3, size_t arg4)
+{
+	if (BUILTIN_EXPECT((sys_nr >= NR_SYSCALLS) || !syscall_table[sys_nr], 0)) {
+		kprintf("invalid system call: %lu\n", sys_nr);
+		return -ENOSYS;
+	}
+
+	return syscall_table[sys_nr](arg0, arg1, arg2, arg3, arg4);
 }
@@ -32,23 +32,59 @@
 #include <eduos/tasks.h>
 #include <eduos/tasks_types.h>
 #include <eduos/spinlock.h>
+#include <eduos/rwlock.h>
 #include <eduos/errno.h>
 #include <eduos/syscall.h>
 #include <eduos/memory.h>
+#include <eduos/fs.h>
+#include <eduos/time.h>
 
-/** @brief Array of task structures (aka PCB)
+/// number of task structures in a chunk of the task table
+#define TASKS_PER_CHUNK		16
+/// number of chunks, which are required to manage MAX_TASKS tasks
+#define TASK_CHUNKS		((MAX_TASKS + TASKS_PER_CHUNK - 1) / TASKS_PER_CHUNK)
+
+/** @brief First chunk of the task table
+ *
+ * It contains the idle task of the boot processor and is
+ * available before the memory management is initialized.
+ */
+static task_t task_chunk0[TASKS_PER_CHUNK] = { \
+		[0]                       = {0, TASK_IDLE, NULL, NULL, TASK_DEFAULT_FLAGS, 0, 0, 0, 0, SPINLOCK_IRQSAVE_INIT, RWLOCK_INIT, NULL, NULL, ATOMIC_INIT(0), NULL, NULL}, \
+		[1 ... TASKS_PER_CHUNK-1] = {0, TASK_INVALID, NULL, NULL, TASK_DEFAULT_FLAGS, 0, 0, 0, 0, SPINLOCK_IRQSAVE_INIT, RWLOCK_INIT, NULL, NULL,ATOMIC_INIT(0), NULL, NULL}};
+
+/** @brief Two-level table of task structures (aka PCB)
  *
- * A task's id will be its position in this array.
+ * The task with the id i is entry (i % TASKS_PER_CHUNK) of chunk
+ * (i / TASKS_PER_CHUNK). Chunks are allocated, when a task claims
+ * the first slot of a chunk, and are never released.
  */
-static task_t task_table[MAX_TASKS] = { \
-		[0]                 = {0, TASK_IDLE, NULL, NULL, TASK_DEFAULT_FLAGS, 0, 0, SPINLOCK_IRQSAVE_INIT, SPINLOCK_INIT, NULL, NULL, ATOMIC_INIT(0), NULL, NULL}, \
-		[1 ... MAX_TASKS-1] = {0, TASK_INVALID, NULL, NULL, TASK_DEFAULT_FLAGS, 0, 0, SPINLOCK_IRQSAVE_INIT, SPINLOCK_INIT, NULL, NULL,ATOMIC_INIT(0), NULL, NULL}};
+static task_t* task_table[TASK_CHUNKS] = {[0] = task_chunk0};
+/// serializes the allocation of chunks
+static spinlock_t chunk_lock = SPINLOCK_INIT;
 
-static spinlock_irqsave_t table_lock = SPINLOCK_IRQSAVE_INIT;
+/// number of bits in a word of the slot bitmap
+#define SLOT_BITS	(sizeof(size_t)*8)
+/// number of words of the slot bitmap
+#define SLOT_WORDS	((MAX_TASKS + SLOT_BITS - 1) / SLOT_BITS)
 
-static readyqueues_t readyqueues = {task_table+0, NULL, 0, 0, {[0 ... MAX_PRIO-2] = {NULL, NULL}}, SPINLOCK_IRQSAVE_INIT};
+/** @brief Bitmap of the free slots in the task table
+ *
+ * A set bit marks a free slot. A slot is claimed by an
+ * atomic test-and-clear of its bit.
+ */
+static volatile size_t task_slots[SLOT_WORDS] = {[0 ... SLOT_WORDS-1] = 0};
+/// word of the slot bitmap, which contained the last free slot
+static uint32_t slot_hint = 0;
 
-task_t* current_task = task_table+0;
+/** @brief Each core owns its ready queue
+ *
+ * The idle task of a core is set, if the core is online.
+ */
+static readyqueues_t readyqueues[MAX_CORES] = { \
+		[0 ... MAX_CORES-1] = {NULL, NULL, 0, 0, {[0 ... MAX_PRIO-2] = {NULL, NULL}}, SPINLOCK_IRQSAVE_INIT}};
+
+DEFINE_PER_CORE(task_t*, current_task, task_chunk0+0);
 extern const void boot_stack;
 
 /** @brief helper function for the assembly code to determine the current task
@@ -56,24 +92,312 @@ extern const void boot_stack;
  */
 task_t* get_current_task(void)
 {
-	return current_task;
+	return per_core(current_task);
 }
 
 uint32_t get_highest_priority(void)
 {
-	return msb(readyqueues.prio_bitmap);
+	return msb(readyqueues[CORE_ID].prio_bitmap);
+}
+
+/** @brief Append a task to a ready queue
+ *
+ * The caller has to hold the lock of the ready queue.
+ */
+static void readyqueues_push_back(uint32_t core_id, task_t* task)
+{
+	uint32_t prio = task->prio;
+	task_list_t* list = &readyqueues[core_id].queue[prio-1];
+
+	task->next = NULL;
+	if (!list->first) {
+		task->prev = NULL;
+		list->first = list->last = task;
+	} else {
+		task->prev = list->last;
+		list->last->next = task;
+		list->last = task;
+	}
+	readyqueues[core_id].prio_bitmap |= (1 << prio);
+}
+
+/** @brief Remove a task from a ready queue
+ *
+ * The caller has to hold the lock of the ready queue.
+ */
+static void readyqueues_remove(uint32_t core_id, task_t* task)
+{
+	uint32_t prio = task->prio;
+	task_list_t* list = &readyqueues[core_id].queue[prio-1];
+
+	if (task->prev)
+		task->prev->next = task->next;
+	if (task->next)
+		task->next->prev = task->prev;
+	if (list->first == task)
+		list->first = task->next;
+	if (list->last == task)
+		list->last = task->prev;
+	task->next = task->prev = NULL;
+
+	// No valid task in queue => update prio_bitmap
+	if (!list->first)
+		readyqueues[core_id].prio_bitmap &= ~(1 << prio);
+}
+
+/** @brief Claim a free slot of the task table
+ *
+ * @return
+ * - the id of the claimed slot
+ * - -ENOMEM (-12) if the task table is full
+ */
+static int claim_task_slot(void)
+{
+	uint32_t n, word;
+	size_t bits, bit;
+
+	for(n=0; n<SLOT_WORDS; n++) {
+		word = (slot_hint + n) % SLOT_WORDS;
+		while ((bits = task_slots[word]) != 0) {
+			bit = lsb(bits);
+			if (atomic_test_and_clear_bit(bit, task_slots+word)) {
+				slot_hint = word;
+				return word * SLOT_BITS + bit;
+			}
+		}
+	}
+
+	return -ENOMEM;
+}
+
+/** @brief Release a slot of the task table */
+static void release_task_slot(tid_t id)
+{
+	atomic_set_bit(id % SLOT_BITS, task_slots + id / SLOT_BITS);
+}
+
+/** @brief Determine the task structure of a task id
+ *
+ * @return Pointer to the task structure or NULL, if its chunk doesn't exist
+ */
+static inline task_t* get_task(tid_t id)
+{
+	task_t* chunk;
+
+	if (BUILTIN_EXPECT(id >= MAX_TASKS, 0))
+		return NULL;
+
+	chunk = task_table[id / TASKS_PER_CHUNK];
+	if (BUILTIN_EXPECT(!chunk, 0))
+		return NULL;
+
+	return chunk + id % TASKS_PER_CHUNK;
+}
+
+/** @brief Determine the task structure of a claimed slot
+ *
+ * Allocates the chunk of the task table, which contains the slot,
+ * if it doesn't already exist.
+ *
+ * @return Pointer to the task structure or NULL on failure
+ */
+static task_t* alloc_task(tid_t id)
+{
+	const size_t sz = TASKS_PER_CHUNK * sizeof(task_t);
+	uint32_t n = id / TASKS_PER_CHUNK;
+	task_t* chunk;
+
+	if (task_table[n])
+		return task_table[n] + id % TASKS_PER_CHUNK;
+
+	spinlock_lock(&chunk_lock);
+	if (!task_table[n]) {
+		chunk = (task_t*) palloc(sz, 0);
+		if (BUILTIN_EXPECT(!chunk, 0)) {
+			spinlock_unlock(&chunk_lock);
+			return NULL;
+		}
+
+		// all tasks of the new chunk are invalid (TASK_INVALID == 0)
+		memset(chunk, 0x00, sz);
+		task_table[n] = chunk;
+	}
+	spinlock_unlock(&chunk_lock);
+
+	return task_table[n] + id % TASKS_PER_CHUNK;
+}
+
+uint32_t get_next_core_id(void)
+{
+	uint32_t i, core_id = CORE_ID;
+	uint32_t nr_tasks = readyqueues[core_id].nr_tasks;
+
+	// use the online core with the smallest number of ready tasks
+	for(i=0; i<MAX_CORES; i++) {
+		if (readyqueues[i].idle && (readyqueues[i].nr_tasks < nr_tasks)) {
+			nr_tasks = readyqueues[i].nr_tasks;
+			core_id = i;
+		}
+	}
+
+	return core_id;
+}
+
+#if MAX_CORES > 1
+#define current_task_of(core_id)	(current_task[(core_id)].var)
+#else
+#define current_task_of(core_id)	(current_task)
+#endif
+
+/** @brief Signalize a core that a task with a higher priority is ready
+ *
+ * Without a periodic timer, an idle core sleeps until the next interrupt.
+ * If the core of the task doesn't switch to the task, an idle core is
+ * woken up to steal it. The IPI is also sent to the calling core, which
+ * runs the scheduler as soon as it enables the interrupts.
+ */
+static void wakeup_core(uint32_t core_id, uint32_t prio)
+{
+	task_t* curr_task;
+#if MAX_CORES > 1
+	uint32_t i;
+#endif
+
+	curr_task = current_task_of(core_id);
+	if (curr_task && (curr_task->prio < prio)) {
+		apic_send_ipi(core_id, 121);
+		return;
+	}
+
+#if MAX_CORES > 1
+	for(i=0; i<MAX_CORES; i++) {
+		if ((i != core_id) && readyqueues[i].idle && (current_task_of(i) == readyqueues[i].idle)) {
+			apic_send_ipi(i, 121);
+			return;
+		}
+	}
+#endif
+}
+
+#if MAX_CORES > 1
+
+/** @brief Steal a ready task from the busiest core
+ *
+ * The calling core takes the task, which is waiting longest in the
+ * list of the highest priority of the busiest core.
+ * The caller must not hold the lock of its own ready queue.
+ */
+static void steal_task(uint32_t core_id)
+{
+	uint32_t i, prio, victim = MAX_CORES;
+	uint32_t nr_tasks = 1;
+	task_t* task = NULL;
+
+	// determine the busiest core, which has a task in its ready queue
+	for(i=0; i<MAX_CORES; i++) {
+		if ((i != core_id) && readyqueues[i].prio_bitmap && (readyqueues[i].nr_tasks > nr_tasks)) {
+			nr_tasks = readyqueues[i].nr_tasks;
+			victim = i;
+		}
+	}
+
+	if (victim >= MAX_CORES)
+		return;
+
+	spinlock_irqsave_lock(&readyqueues[victim].lock);
+	prio = msb(readyqueues[victim].prio_bitmap);
+	if (prio <= MAX_PRIO) {
+		task = readyqueues[victim].queue[prio-1].first;
+		readyqueues_remove(victim, task);
+		readyqueues[victim].nr_tasks--;
+	}
+	spinlock_irqsave_unlock(&readyqueues[victim].lock);
+
+	if (!task)
+		return;
+
+	spinlock_irqsave_lock(&readyqueues[core_id].lock);
+	task->last_core = core_id;
+	readyqueues[core_id].nr_tasks++;
+	readyqueues_push_back(core_id, task);
+	spinlock_irqsave_unlock(&readyqueues[core_id].lock);
+}
+#endif
+
+/** @brief Callback of the timeout timer of a task */
+static void task_timeout(void* arg)
+{
+	wakeup_task((tid_t) (size_t) arg);
 }
 
 int multitasking_init(void)
 {
-	if (BUILTIN_EXPECT(task_table[0].status != TASK_IDLE, 0)) {
+	uint32_t i;
+
+	if (BUILTIN_EXPECT(task_chunk0[0].status != TASK_IDLE, 0)) {
 		kputs("Task 0 is not an idle task\n");
 		return -ENOMEM;
 	}
 
-	task_table[0].prio = IDLE_PRIO;
-	task_table[0].stack = (void*) &boot_stack;
-	task_table[0].page_map = read_cr3();
+	// all slots except the slot of the idle task are free
+	for(i=1; i<MAX_TASKS; i++)
+		release_task_slot(i);
+
+	task_chunk0[0].prio = IDLE_PRIO;
+	task_chunk0[0].last_core = 0;
+	task_chunk0[0].stack = (void*) &boot_stack;
+	task_chunk0[0].page_map = read_cr3() & PAGE_MASK;
+	timer_setup(&task_chunk0[0].timer, task_timeout, (void*) 0);
+	readyqueues[0].idle = task_chunk0+0;
+
+	// register idle task
+	register_task();
+
+	return 0;
+}
+
+int set_idle_task(void)
+{
+	uint32_t core_id = CORE_ID;
+	task_t* task;
+	int i;
+
+	if (BUILTIN_EXPECT(readyqueues[core_id].idle != NULL, 0))
+		return -EINVAL;
+
+	i = claim_task_slot();
+	if (BUILTIN_EXPECT(i < 0, 0))
+		return i;
+
+	task = alloc_task(i);
+	if (BUILTIN_EXPECT(!task, 0)) {
+		release_task_slot(i);
+		return -ENOMEM;
+	}
+
+	task->id = i;
+	task->last_stack_pointer = NULL;
+	task->stack = (char*) &boot_stack + core_id * KERNEL_STACK_SIZE;
+	task->flags = TASK_DEFAULT_FLAGS;
+	task->prio = IDLE_PRIO;
+	task->last_core = core_id;
+	rwlock_init(&task->vma_lock);
+	task->vma_list = NULL;
+	task->heap = NULL;
+	spinlock_irqsave_init(&task->page_lock);
+	atomic_int32_set(&task->user_usage, 0);
+	task->page_map = read_cr3() & PAGE_MASK;
+	task->tlb_cores = 0;
+	memset(&task->faults, 0x00, sizeof(fault_stats_t));
+	task->fildes_table = NULL;
+	task->ring = NULL;
+	task->next = task->prev = NULL;
+	task->wait_next = task->wait_prev = NULL;
+	timer_setup(&task->timer, task_timeout, (void*) (size_t) i);
+	task->status = TASK_IDLE;
+
+	set_per_core(current_task, task);
+	readyqueues[core_id].idle = task;
 
 	// register idle task
 	register_task();
@@ -84,53 +408,91 @@ int multitasking_init(void)
 void finish_task_switch(void)
 {
 	task_t* old;
-	uint8_t prio;
-
-	spinlock_irqsave_lock(&readyqueues.lock);
-
-	if ((old = readyqueues.old_task) != NULL) {
-		if (old->status == TASK_INVALID) {
-			old->stack = NULL;
-			old->last_stack_pointer = NULL;
-			readyqueues.old_task = NULL;
-		} else {
-			prio = old->prio;
-			if (!readyqueues.queue[prio-1].first) {
-				old->next = old->prev = NULL;
-				readyqueues.queue[prio-1].first = readyqueues.queue[prio-1].last = old;
-			} else {
-				old->next = NULL;
-				old->prev = readyqueues.queue[prio-1].last;
-				readyqueues.queue[prio-1].last->next = old;
-				readyqueues.queue[prio-1].last = old;
-			}
-			readyqueues.old_task = NULL;
-			readyqueues.prio_bitmap |= (1 << prio);
-		}
+	uint32_t core_id = CORE_ID;
+
+	spinlock_irqsave_lock(&readyqueues[core_id].lock);
+
+	/*
+	 * The context of the previous task is saved. Now, other cores
+	 * are able to run it or to reuse its slot in the task table.
+	 */
+	if ((old = readyqueues[core_id].old_task) != NULL) {
+		if (old->status == TASK_READY)
+			readyqueues_push_back(core_id, old);
+		readyqueues[core_id].old_task = NULL;
 	}
 
-	spinlock_irqsave_unlock(&readyqueues.lock);
+	spinlock_irqsave_unlock(&readyqueues[core_id].lock);
+
+	/*
+	 * The stack remains assigned to the slot and is reused by the
+	 * next task, which claims the slot.
+	 */
+	if (old && (old->status == TASK_FINISHED)) {
+		old->last_stack_pointer = NULL;
+		old->status = TASK_INVALID;
+		release_task_slot(old->id);
+	}
 
-	if (current_task->heap)
-		kfree(current_task->heap);
+	if (per_core(current_task)->heap)
+		kfree(per_core(current_task)->heap);
 }
 
 /** @brief A procedure to be called by
  * procedures which are called by exiting tasks. */
 static void NORETURN do_exit(int arg)
 {
-	task_t* curr_task = current_task;
+	task_t* curr_task = per_core(current_task);
+	uint32_t core_id;
+	uint8_t flags;
+	int fd;
 
 	kprintf("Terminate task: %u, return value %d\n", curr_task->id, arg);
 
+	// the clock page belongs to the kernel
+	vclock_unmap();
 	page_map_drop();
+	// the system call ring was part of the user space
+	curr_task->ring = NULL;
+
+	// release the open files
+	if (curr_task->fildes_table) {
+		for(fd=0; fd<NR_OPEN; fd++) {
+			fildes_t* file = curr_task->fildes_table[fd];
+
+			if (file && !--file->count) {
+				close_fs(file);
+				kmem_cache_free(&fildes_cache, file);
+			}
+		}
+
+		kfree(curr_task->fildes_table);
+		curr_task->fildes_table = NULL;
+	}
+
+	// release the user VMAs
+	write_lock(&curr_task->vma_lock);
+	while (curr_task->vma_list) {
+		vma_t* vma = curr_task->vma_list;
+
+		curr_task->vma_list = vma->next;
+		kfree(vma);
+	}
+	write_unlock(&curr_task->vma_lock);
 
-	// decrease the number of active tasks
-	spinlock_irqsave_lock(&readyqueues.lock);
-	readyqueues.nr_tasks--;
-	spinlock_irqsave_unlock(&readyqueues.lock);
+	/*
+	 * Decrease the number of active tasks. The task may have been
+	 * migrated in the meantime, so the core is determined now. Until
+	 * the task is finished, it isn't preempted (and stolen) anymore.
+	 */
+	flags = irq_nested_disable();
+	core_id = CORE_ID;
+	spinlock_irqsave_lock(&readyqueues[core_id].lock);
+	readyqueues[core_id].nr_tasks--;
+	spinlock_irqsave_unlock(&readyqueues[core_id].lock);
 
 	curr_task->status = TASK_FINISHED;
+	irq_nested_enable(flags);
 	reschedule();
 
 	kprintf("Kernel panic: scheduler found no valid task\n");
@@ -157,10 +519,10 @@ void NORETURN abort(void) {
 	do_exit(-1);
 }
 
-int create_task(tid_t* id, entry_point_t ep, void* arg, uint8_t prio)
+int create_task(tid_t* id, entry_point_t ep, void* arg, uint8_t prio, uint32_t core_id)
 {
-	int ret = -ENOMEM;
-	uint32_t i;
+	task_t* task;
+	int i, ret;
 
 	if (BUILTIN_EXPECT(!ep, 0))
 		return -EINVAL;
@@ -168,67 +530,103 @@ int create_task(tid_t* id, entry_point_t ep, void* arg, uint8_t prio)
 		return -EINVAL;
 	if (BUILTIN_EXPECT(prio > MAX_PRIO, 0))
 		return -EINVAL;
+	if (BUILTIN_EXPECT(core_id >= MAX_CORES, 0))
+		return -EINVAL;
+	if (BUILTIN_EXPECT(!readyqueues[core_id].idle, 0))
+		return -EINVAL;
 
-	spinlock_irqsave_lock(&table_lock);
-
-	for(i=0; i<MAX_TASKS; i++) {
-		if (task_table[i].status == TASK_INVALID) {
-			task_table[i].id = i;
-			task_table[i].status = TASK_READY;
-			task_table[i].last_stack_pointer = NULL;
-			task_table[i].stack = create_stack(i);
-			task_table[i].prio = prio;
-			spinlock_init(&task_table[i].vma_lock);
-			task_table[i].vma_list = NULL;
-			task_table[i].heap = NULL;
-
-			spinlock_irqsave_init(&task_table[i].page_lock);
-			atomic_int32_set(&task_table[i].user_usage, 0);
-
-			/* Allocated new PGD or PML4 and copy page table */
-			task_table[i].page_map = get_pages(1);
-			if (BUILTIN_EXPECT(!task_table[i].page_map, 0))
-				goto out;
-
-			/* Copy page tables & user frames of current task to new one */
-			page_map_copy(&task_table[i]);
-
-			if (id)
-				*id = i;
-
-			ret = create_default_frame(task_table+i, ep, arg);
-
-			// add task in the readyqueues
-			spinlock_irqsave_lock(&readyqueues.lock);
-			readyqueues.prio_bitmap |= (1 << prio);
-			readyqueues.nr_tasks++;
-			if (!readyqueues.queue[prio-1].first) {
-				task_table[i].next = task_table[i].prev = NULL;
-				readyqueues.queue[prio-1].first = task_table+i;
-				readyqueues.queue[prio-1].last = task_table+i;
-			} else {
-				task_table[i].prev = readyqueues.queue[prio-1].last;
-				task_table[i].next = NULL;
-				readyqueues.queue[prio-1].last->next = task_table+i;
-				readyqueues.queue[prio-1].last = task_table+i;
-			}
-			spinlock_irqsave_unlock(&readyqueues.lock);
-			break;
+	i = claim_task_slot();
+	if (BUILTIN_EXPECT(i < 0, 0))
+		return i;
+
+	/*
+	 * The slot belongs to us and the task isn't visible in a ready queue.
+	 * Therefore, we are able to initialize the task without any lock.
+	 */
+	task = alloc_task(i);
+	if (BUILTIN_EXPECT(!task, 0)) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	// reuse the stack of a previous task
+	if (!task->stack) {
+		task->stack = create_stack(KERNEL_STACK_SIZE);
+		if (BUILTIN_EXPECT(!task->stack, 0)) {
+			ret = -ENOMEM;
+			goto out;
 		}
 	}
 
+	task->id = i;
+	task->last_stack_pointer = NULL;
+	task->flags = TASK_DEFAULT_FLAGS;
+	task->prio = prio;
+	task->last_core = core_id;
+	rwlock_init(&task->vma_lock);
+	task->vma_list = NULL;
+	task->heap = NULL;
+	task->wait_next = task->wait_prev = NULL;
+	timer_setup(&task->timer, task_timeout, (void*) (size_t) i);
+
+	spinlock_irqsave_init(&task->page_lock);
+	atomic_int32_set(&task->user_usage, 0);
+	task->tlb_cores = 0;
+	memset(&task->faults, 0x00, sizeof(fault_stats_t));
+	task->fildes_table = NULL;
+	task->ring = NULL;
+
+	ret = create_default_frame(task, ep, arg);
+	if (BUILTIN_EXPECT(ret, 0))
+		goto out;
+
+	/* Allocated new PGD or PML4 and copy page table */
+	task->page_map = get_page();
+	if (BUILTIN_EXPECT(!task->page_map, 0)) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	/* Copy page tables & user frames of current task to new one.
+	 * On failure, page_map_copy() has already released the copied tables. */
+	ret = page_map_copy(task);
+	if (BUILTIN_EXPECT(ret, 0)) {
+		put_page(task->page_map);
+		task->page_map = 0;
+		goto out;
+	}
+
+	if (id)
+		*id = i;
+
+	// add task in the readyqueues
+	spinlock_irqsave_lock(&readyqueues[core_id].lock);
+	task->status = TASK_READY;
+	readyqueues[core_id].nr_tasks++;
+	readyqueues_push_back(core_id, task);
+	spinlock_irqsave_unlock(&readyqueues[core_id].lock);
+
+	wakeup_core(core_id, prio);
+
+	return 0;
+
 out:
-	spinlock_irqsave_unlock(&table_lock);
+	release_task_slot(i);
 
 	return ret;
 }
 
-int create_kernel_task(tid_t* id, entry_point_t ep, void* args, uint8_t prio)
+int create_kernel_task_on_core(tid_t* id, entry_point_t ep, void* args, uint8_t prio, uint32_t core_id)
 {
 	if (prio > MAX_PRIO)
 		prio = NORMAL_PRIO;
 
-	return create_task(id, ep, args, prio);
+	return create_task(id, ep, args, prio, core_id);
+}
+
+int create_kernel_task(tid_t* id, entry_point_t ep, void* args, uint8_t prio)
+{
+	return create_kernel_task_on_core(id, ep, args, prio, get_next_core_id());
 }
 
 /** @brief Wakeup a blocked task
@@ -240,38 +638,40 @@ int create_kernel_task(tid_t* id, entry_point_t ep, void* args, uint8_t prio)
 int wakeup_task(tid_t id)
 {
 	task_t* task;
-	uint32_t prio;
+	uint32_t core_id;
 	int ret = -EINVAL;
-	uint8_t flags;
 
-	flags = irq_nested_disable();
+	task = get_task(id);
+	if (BUILTIN_EXPECT(!task, 0))
+		return -EINVAL;
+
+	// the task doesn't longer wait for its timeout
+	timer_del(&task->timer);
 
-	task = task_table + id;
-	prio = task->prio;
+	core_id = task->last_core;
+
+	spinlock_irqsave_lock(&readyqueues[core_id].lock);
 
 	if (task->status == TASK_BLOCKED) {
 		task->status = TASK_READY;
 		ret = 0;
 
-		spinlock_irqsave_lock(&readyqueues.lock);
 		// increase the number of ready tasks
-		readyqueues.nr_tasks++;
-
-		// add task to the runqueue
-		if (!readyqueues.queue[prio-1].last) {
-			readyqueues.queue[prio-1].last = readyqueues.queue[prio-1].first = task;
-			task->next = task->prev = NULL;
-			readyqueues.prio_bitmap |= (1 << prio);
-		} else {
-			task->prev = readyqueues.queue[prio-1].last;
-			task->next = NULL;
-			readyqueues.queue[prio-1].last->next = task;
-			readyqueues.queue[prio-1].last = task;
-		}
-		spinlock_irqsave_unlock(&readyqueues.lock);
+		readyqueues[core_id].nr_tasks++;
+
+		/*
+		 * If the task didn't leave its core, its context isn't saved.
+		 * In this case, the scheduler or finish_task_switch()
+		 * requeue the task.
+		 */
+		if ((task != current_task_of(core_id)) && (task != readyqueues[core_id].old_task))
+			readyqueues_push_back(core_id, task);
 	}
 
-	irq_nested_enable(flags);
+	spinlock_irqsave_unlock(&readyqueues[core_id].lock);
+
+	if (!ret)
+		wakeup_core(core_id, task->prio);
 
 	return ret;
 }
@@ -286,43 +686,49 @@ int wakeup_task(tid_t id)
  */
 int block_current_task(void)
 {
-	tid_t id;
-	uint32_t prio;
+	task_t* curr_task;
+	uint32_t core_id;
 	int ret = -EINVAL;
 	uint8_t flags;
 
 	flags = irq_nested_disable();
 
-	id = current_task->id;
-	prio = current_task->prio;
+	curr_task = per_core(current_task);
+	core_id = CORE_ID;
 
-	if (task_table[id].status == TASK_RUNNING) {
-		task_table[id].status = TASK_BLOCKED;
+	spinlock_irqsave_lock(&readyqueues[core_id].lock);
+
+	if (curr_task->status == TASK_RUNNING) {
+		curr_task->status = TASK_BLOCKED;
 		ret = 0;
 
-		spinlock_irqsave_lock(&readyqueues.lock);
 		// reduce the number of ready tasks
-		readyqueues.nr_tasks--;
+		readyqueues[core_id].nr_tasks--;
 
 		// remove task from queue
-		if (task_table[id].prev)
-			task_table[id].prev->next = task_table[id].next;
-		if (task_table[id].next)
-			task_table[id].next->prev = task_table[id].prev;
-		if (readyqueues.queue[prio-1].first == task_table+id)
-			readyqueues.queue[prio-1].first = task_table[id].next;
-		if (readyqueues.queue[prio-1].last == task_table+id) {
-			readyqueues.queue[prio-1].last = task_table[id].prev;
-			if (!readyqueues.queue[prio-1].last)
-				readyqueues.queue[prio-1].last = readyqueues.queue[prio-1].first;
-		}
-
-		// No valid task in queue => update prio_bitmap
-		if (!readyqueues.queue[prio-1].first)
-			readyqueues.prio_bitmap &= ~(1 << prio);
-		spinlock_irqsave_unlock(&readyqueues.lock);
+		readyqueues_remove(core_id, curr_task);
 	}
 
+	spinlock_irqsave_unlock(&readyqueues[core_id].lock);
+
+	irq_nested_enable(flags);
+
+	return ret;
+}
+
+int block_current_task_timeout(uint64_t deadline)
+{
+	task_t* curr_task;
+	int ret;
+	uint8_t flags;
+
+	flags = irq_nested_disable();
+
+	curr_task = per_core(current_task);
+	ret = block_current_task();
+	if (!ret)
+		timer_add(&curr_task->timer, deadline);
+
 	irq_nested_enable(flags);
 
 	return ret;
@@ -331,60 +737,73 @@ int block_current_task(void)
 size_t** scheduler(void)
 {
 	task_t* orig_task;
+	task_t* curr_task;
+	uint32_t core_id = CORE_ID;
 	uint32_t prio;
 
-	orig_task = current_task;
+	orig_task = curr_task = per_core(current_task);
+
+#if MAX_CORES > 1
+	// nothing to do => try to get a task from another core
+	if (!readyqueues[core_id].prio_bitmap && (curr_task->status != TASK_RUNNING)
+	    && (curr_task->status != TASK_READY))
+		steal_task(core_id);
+#endif
 
-	spinlock_irqsave_lock(&readyqueues.lock);
+	spinlock_irqsave_lock(&readyqueues[core_id].lock);
 
-	/* signalizes that this task could be reused */
-	if (current_task->status == TASK_FINISHED) {
-		current_task->status = TASK_INVALID;
-		readyqueues.old_task = current_task;
-	} else readyqueues.old_task = NULL; // reset old task
+	// the task was woken up, before it was able to leave the core
+	if (curr_task->status == TASK_READY)
+		curr_task->status = TASK_RUNNING;
 
-	prio = msb(readyqueues.prio_bitmap); // determines highest priority
+	prio = msb(readyqueues[core_id].prio_bitmap); // determines highest priority
 	if (prio > MAX_PRIO) {
-		if ((current_task->status == TASK_RUNNING) || (current_task->status == TASK_IDLE))
+		if ((curr_task->status == TASK_RUNNING) || (curr_task->status == TASK_IDLE))
 			goto get_task_out;
-		current_task = readyqueues.idle;
+		curr_task = readyqueues[core_id].idle;
 	} else {
 		// Does the current task have an higher priority? => no task switch
-		if ((current_task->prio > prio) && (current_task->status == TASK_RUNNING))
+		if ((curr_task->prio > prio) && (curr_task->status == TASK_RUNNING))
 			goto get_task_out;
 
-		if (current_task->status == TASK_RUNNING) {
-			current_task->status = TASK_READY;
-			readyqueues.old_task = current_task;
-		}
+		if (curr_task->status == TASK_RUNNING)
+			curr_task->status = TASK_READY;
 
-		current_task = readyqueues.queue[prio-1].first;
-		if (BUILTIN_EXPECT(current_task->status == TASK_INVALID, 0)) {
-			kprintf("Upps!!!!!!! Got invalid task %d, orig task %d\n", current_task->id, orig_task->id);
+		curr_task = readyqueues[core_id].queue[prio-1].first;
+		if (BUILTIN_EXPECT(curr_task->status == TASK_INVALID, 0)) {
+			kprintf("Upps!!!!!!! Got invalid task %d, orig task %d\n", curr_task->id, orig_task->id);
 		}
-		current_task->status = TASK_RUNNING;
+		curr_task->status = TASK_RUNNING;
+		curr_task->last_core = core_id;
 
 		// remove new task from queue
 		// by the way, priority 0 is only used by the idle task and doesn't need own queue
-		readyqueues.queue[prio-1].first = current_task->next;
-		if (!current_task->next) {
-			readyqueues.queue[prio-1].last = NULL;
-			readyqueues.prio_bitmap &= ~(1 << prio);
-		}
-		current_task->next = current_task->prev = NULL;
+		readyqueues_remove(core_id, curr_task);
 	}
 
+	/*
+	 * finish_task_switch() requeues or releases the original task,
+	 * after its context is saved
+	 */
+	if ((curr_task != orig_task) && (orig_task->status != TASK_IDLE))
+		readyqueues[core_id].old_task = orig_task;
+
 get_task_out:
-	spinlock_irqsave_unlock(&readyqueues.lock);
+	set_per_core(current_task, curr_task);
+
+	spinlock_irqsave_unlock(&readyqueues[core_id].lock);
+
+	if (curr_task != orig_task) {
+		// start a new time slice or stop the timer, if the core becomes idle
+		timer_reprogram();
 
-	if (current_task != orig_task) {
 		/* if the original task is using the FPU, we need to save the FPU context */
-		if ((orig_task->flags & TASK_FPU_USED) && (orig_task->status == TASK_READY)) {
+		if ((orig_task->flags & TASK_FPU_USED) && (orig_task->status != TASK_FINISHED)) {
 			save_fpu_state(&(orig_task->fpu));
 			orig_task->flags &= ~TASK_FPU_USED;
 		}
 
-		//kprintf("schedule from %u to %u with prio %u\n", orig_task->id, current_task->id, (uint32_t)current_task->prio);
+		//kprintf("schedule from %u to %u with prio %u\n", orig_task->id, curr_task->id, (uint32_t)curr_task->prio);
 
 		return (size_t**) &(orig_task->last_stack_pointer);
 	}
@@ -30,6 +30,7 @@
 #include <eduos/string.h>
 #include <eduos/stdarg.h>
 #include <eduos/spinlock.h>
+#include <eduos/rwlock.h>
 #include <eduos/fs.h>
 #include <asm/atomic.h>
 #include <asm/processor.h>
@@ -110,7 +111,7 @@ int kmsg_init(vfs_node_t * node, const char *name)
 	if (finddir_fs(node, name))
 		return -EINVAL;
 
-	new_node = kmalloc(sizeof(vfs_node_t));
+	new_node = kmem_cache_alloc(&vfs_node_cache);
 	if (BUILTIN_EXPECT(!new_node, 0))
 		return -ENOMEM;
 
@@ -120,7 +121,7 @@ int kmsg_init(vfs_node_t * node, const char *name)
 	new_node->close = &kmsg_close;
 	new_node->read = &kmsg_read;
 	new_node->write = NULL;
-	spinlock_init(&new_node->lock);
+	rwlock_init(&new_node->lock);
 
 	blist = &node->block_list;
 	do {
@@ -139,13 +140,13 @@ int kmsg_init(vfs_node_t * node, const char *name)
 		}
 
 		if (!blist->next) {
-			blist->next = (block_list_t *) kmalloc(sizeof(block_list_t));
+			blist->next = (block_list_t *) kmem_cache_alloc(&block_list_cache);
 			if (blist->next)
 				memset(blist->next, 0x00, sizeof(block_list_t));
 		}
 	} while (blist);
 
-	kfree(new_node);
+	kmem_cache_free(&vfs_node_cache, new_node);
 
 	return -ENOMEM;
 }
@@ -32,13 +32,15 @@
 #include <eduos/stdio.h>
 #include <eduos/malloc.h>
 #include <eduos/spinlock.h>
+#include <eduos/mutex.h>
 #include <eduos/memory.h>
+#include <eduos/vma.h>
 #include <asm/page.h>
 
 /// A linked list for each binary size exponent
 static buddy_t* buddy_lists[BUDDY_LISTS] = { [0 ... BUDDY_LISTS-1] = NULL };
 /// Lock for the buddy lists
-static spinlock_t buddy_lock = SPINLOCK_INIT;
+static mutex_t buddy_lock = MUTEX_INIT;
 
 /** @brief Check if larger free buddies are available */
 static inline int buddy_large_avail(uint8_t exp)
@@ -63,22 +65,109 @@ static inline int buddy_exp(size_t sz)
 	return exp;
 }
 
+/** @brief Push a free buddy of size 2^exp to its list */
+static inline void buddy_push(buddy_t* buddy, int exp)
+{
+	buddy_t** list = &buddy_lists[exp-BUDDY_MIN];
+
+	buddy->prefix.exponent = exp;
+	buddy->prefix.magic = BUDDY_FREE;
+	buddy[1].next = *list;
+	buddy[2].prev = NULL;
+	if (*list)
+		(*list)[2].prev = buddy;
+	*list = buddy;
+}
+
+/** @brief Remove a free buddy of size 2^exp from its list */
+static inline void buddy_remove(buddy_t* buddy, int exp)
+{
+	if (buddy[2].prev)
+		buddy[2].prev[1].next = buddy[1].next;
+	else
+		buddy_lists[exp-BUDDY_MIN] = buddy[1].next;
+	if (buddy[1].next)
+		buddy[1].next[2].prev = buddy[2].prev;
+
+	// a block in use carries BUDDY_MAGIC or belongs to a larger block
+	buddy->prefix.magic = 0;
+}
+
+/** @brief Remove a buddy from the free list of size 2^exp
+ *
+ * @return
+ * - 1 if the buddy was on the list
+ * - 0 if it is in use (or split)
+ */
+static inline int buddy_unlink(buddy_t* buddy, int exp)
+{
+	if (buddy->prefix.magic != BUDDY_FREE || buddy->prefix.exponent != exp)
+		return 0;
+
+	// the prefix is only a hint, the links of the list are authoritative
+	if (buddy[2].prev ? buddy[2].prev[1].next != buddy : buddy_lists[exp-BUDDY_MIN] != buddy)
+		return 0;
+
+	buddy_remove(buddy, exp);
+
+	return 1;
+}
+
+/** @brief Map a new block of 2^exp bytes which is aligned to its size */
+static buddy_t* buddy_fill(int exp)
+{
+	size_t sz, slack, viraddr, start, phyaddr;
+	uint32_t npages;
+
+	if (BUILTIN_EXPECT(exp >= 8*sizeof(size_t)-1, 0))
+		return NULL;
+
+	sz = 1UL << exp;
+	slack = sz - PAGE_SIZE;
+	npages = sz >> PAGE_BITS;
+
+	// reserve enough address space for an aligned block
+	viraddr = vma_alloc(sz+slack, VMA_HEAP);
+	if (BUILTIN_EXPECT(!viraddr, 0))
+		return NULL;
+
+	// ... and give back the unaligned head and tail
+	start = (viraddr + sz - 1) & ~(sz - 1);
+	if (start > viraddr)
+		vma_free(viraddr, start);
+	if (start + sz < viraddr + sz + slack)
+		vma_free(start + sz, viraddr + sz + slack);
+
+	phyaddr = get_pages(npages);
+	if (BUILTIN_EXPECT(!phyaddr, 0)) {
+		vma_free(start, start + sz);
+		return NULL;
+	}
+
+	if (BUILTIN_EXPECT(page_map(start, phyaddr, npages, PG_RW|PG_GLOBAL|PG_HUGE), 0)) {
+		vma_free(start, start + sz);
+		put_pages(phyaddr, npages);
+		return NULL;
+	}
+
+	return (buddy_t*) start;
+}
+
 /** @brief Get a free buddy by potentially splitting a larger one */
 static buddy_t* buddy_get(int exp)
 {
-	spinlock_lock(&buddy_lock);
+	mutex_lock(&buddy_lock);
 	buddy_t** list = &buddy_lists[exp-BUDDY_MIN];
 	buddy_t* buddy = *list;
-	buddy_t* split;
 
 	if (buddy)
 		// there is already a free buddy =>
 		// we remove it from the list
-		*list = buddy->next;
+		buddy_remove(buddy, exp);
 	else if (exp >= BUDDY_ALLOC && !buddy_large_avail(exp))
 		// theres no free buddy larger than exp =>
 		// we can allocate new memory
-		buddy = (buddy_t*) palloc(1<<exp, 0);
+		buddy = buddy_fill(exp);
 	else {
 		// we recursivly request a larger buddy...
 		buddy = buddy_get(exp+1);
@@ -86,28 +175,58 @@ static buddy_t* buddy_get(int exp)
 			goto out;
 
 		// ... and split it, by putting the second half back to the list
-		split = (buddy_t*) ((size_t) buddy + (1<<exp));
-		split->next = *list;
-		*list = split;
+		buddy_push((buddy_t*) ((size_t) buddy + (1UL<<exp)), exp);
 	}
 
 out:
-	spinlock_unlock(&buddy_lock);
+	mutex_unlock(&buddy_lock);
 
 	return buddy;
 }
 
 /** @brief Put a buddy back to its free list
  *
- * TODO: merge adjacent buddies (memory compaction)
+ * As long as its buddy is free too, both are merged to a block
+ * of the next size. Blocks of BUDDY_ALLOC and more are never
+ * merged, because they are the (aligned) units of buddy_fill().
  */
 static void buddy_put(buddy_t* buddy)
 {
-	spinlock_lock(&buddy_lock);
-	buddy_t** list = &buddy_lists[buddy->prefix.exponent-BUDDY_MIN];
-	buddy->next = *list;
-	*list = buddy;
-	spinlock_unlock(&buddy_lock);
+	int exp = buddy->prefix.exponent;
+	buddy_t* other;
+
+	mutex_lock(&buddy_lock);
+	while (exp < BUDDY_ALLOC) {
+		other = (buddy_t*) ((size_t) buddy ^ (1UL<<exp));
+		if (!buddy_unlink(other, exp))
+			break;
+
+		if (other < buddy)
+			buddy = other;
+		exp++;
+	}
+
+	buddy_push(buddy, exp);
+	mutex_unlock(&buddy_lock);
+}
+
+void* buddy_alloc(int exp)
+{
+	if (BUILTIN_EXPECT(exp < BUDDY_MIN || exp > BUDDY_MAX, 0))
+		return NULL;
+
+	return buddy_get(exp);
+}
+
+void buddy_free(void* addr, int exp)
+{
+	buddy_t* buddy = (buddy_t*) addr;
+
+	if (BUILTIN_EXPECT(!addr || exp < BUDDY_MIN || exp > BUDDY_MAX, 0))
+		return;
+
+	buddy->prefix.exponent = exp;
+	buddy_put(buddy);
 }
 
 void buddy_dump(void)
@@ -119,11 +238,11 @@ void buddy_dump(void)
 		int exp = i+BUDDY_MIN;
 
 		if (buddy_lists[i])
-			kprintf("buddy_list[%u] (exp=%u, size=%lu bytes):\n", i, exp, 1<<exp);
+			kprintf("buddy_list[%u] (exp=%u, size=%lu bytes):\n", i, exp, 1UL<<exp);
 
-		for (buddy=buddy_lists[i]; buddy; buddy=buddy->next) {
-			kprintf("  %p -> %p \n", buddy, buddy->next);
-			free += 1<<exp;
+		for (buddy=buddy_lists[i]; buddy; buddy=buddy[1].next) {
+			kprintf("  %p -> %p \n", buddy, buddy[1].next);
+			free += 1UL<<exp;
 		}
 	}
 	kprintf("free buddies: %lu bytes\n", free);
@@ -150,7 +269,7 @@ void* palloc(size_t sz, uint32_t flags)
 	}
 
 	// map physical pages to VMA
-	err = page_map(viraddr, phyaddr, npages, PG_RW|PG_GLOBAL);
+	err = page_map(viraddr, phyaddr, npages, PG_RW|PG_GLOBAL|PG_HUGE);
 	if (BUILTIN_EXPECT(err, 0)) {
 		vma_free(viraddr, viraddr+npages*PAGE_SIZE);
 		put_pages(phyaddr, npages);
@@ -30,10 +30,14 @@
 #include <eduos/stdio.h>
 #include <eduos/string.h>
 #include <eduos/spinlock.h>
+#include <eduos/mutex.h>
+#include <eduos/memory.h>
+#include <eduos/vma.h>
 
 #include <asm/atomic.h>
 #include <asm/multiboot.h>
 #include <asm/page.h>
+#include <asm/irqflags.h>
 
 /*
  * Note that linker symbols are not variables, they have no memory allocated for
@@ -42,154 +46,752 @@
 extern const void kernel_start;
 extern const void kernel_end;
 
-static char stack[MAX_TASKS-1][KERNEL_STACK_SIZE];
-static char bitmap[BITMAP_SIZE];
+/// Binary size exponent of the largest block of page frames (1 GiB)
+#define FRAME_MAX_ORDER	18
+/// Marks the end of a free list
+#define FRAME_NONE	((uint32_t) -1)
+/// The page frame is the first one of a free block
+#define FRAME_FREE	(1 << 0)
+/// Number of bits in a bitmap word
+#define BITS_PER_WORD	(8*sizeof(size_t))
+/// Maximal number of available memory regions
+#define MAX_REGIONS	32
+
+/** @brief Descriptor of a physical page frame
+ *
+ * Free blocks of 2^order page frames are linked into a list per order.
+ * Only the descriptor of the first frame of a free block is valid.
+ */
+typedef struct frame {
+	/// Next free block of the same order
+	uint32_t next;
+	/// Previous free block of the same order
+	uint32_t prev;
+	/// Number of additional mappings of an allocated page frame
+	atomic_int32_t shared;
+	/// Binary size exponent of the free block
+	uint8_t order;
+	/// FRAME_FREE or 0
+	uint8_t flags;
+} frame_t;
+
+/// Descriptors of all page frames (mapped 1:1 behind the kernel)
+static frame_t* frames = NULL;
+/// Number of page frames, which are described by frames
+static size_t nframes = 0;
+/// One bit per page frame, which is set if the frame is allocated or reserved
+static size_t* used_map = NULL;
+/// Free lists of the page frame allocator
+static uint32_t free_lists[FRAME_MAX_ORDER+1] = {[0 ... FRAME_MAX_ORDER] = FRAME_NONE};
+
+static mutex_t frame_lock = MUTEX_INIT;
+
+/// Number of page frames in a per-core cache (power of two)
+#define PAGE_CACHE_SIZE		64
+/// Number of page frames, which are moved between a cache and the allocator at once
+#define PAGE_CACHE_BATCH	16
+
+/** @brief Per-core cache of free page frames
+ *
+ * The page frames are kept in a ring. Hot page frames (recently released,
+ * probably still in the CPU cache) are located at the end, cold page
+ * frames at the beginning. The page frames in the cache count as allocated.
+ */
+typedef struct page_cache {
+	/// Index of the coldest page frame
+	uint32_t first;
+	/// Number of page frames in the cache
+	uint32_t count;
+	/// Physical addresses of the page frames
+	size_t pages[PAGE_CACHE_SIZE];
+} __attribute__ ((aligned (CACHE_LINE))) page_cache_t;
 
-static spinlock_t bitmap_lock = SPINLOCK_INIT;
+static page_cache_t page_caches[MAX_CORES];
+
+/// Number of pre-zeroed page frames per core
+#define ZERO_POOL_SIZE		32
+
+/** @brief Per-core pool of page frames, which are already filled with zeros
+ *
+ * The idle task of the core fills the pool by zero_pool_fill().
+ * The page frames in the pool count as allocated.
+ */
+typedef struct zero_pool {
+	/// Number of page frames in the pool
+	uint32_t count;
+	/// Physical addresses of the page frames
+	size_t pages[ZERO_POOL_SIZE];
+} __attribute__ ((aligned (CACHE_LINE))) zero_pool_t;
+
+static zero_pool_t zero_pools[MAX_CORES];
+
+/// Page frames for the page tables of the descriptors (boot time only)
+static size_t early_next = 0;
+static size_t early_end = 0;
+
+/// Available memory regions (in page frames) of the multiboot memory map
+static struct {
+	size_t start;
+	size_t end;
+} regions[MAX_REGIONS];
+static uint32_t nregions = 0;
 
 atomic_int32_t total_pages = ATOMIC_INIT(0);
 atomic_int32_t total_allocated_pages = ATOMIC_INIT(0);
 atomic_int32_t total_available_pages = ATOMIC_INIT(0);
 
-void* create_stack(tid_t id)
+void* create_stack(size_t sz)
 {
-	// idle task uses stack, which is defined in entry.asm
-	if (BUILTIN_EXPECT(!id, 0))
+	size_t phyaddr, viraddr;
+	uint32_t npages = PAGE_FLOOR(sz) >> PAGE_BITS;
+	int err;
+
+	if (BUILTIN_EXPECT(!npages, 0))
+		return NULL;
+
+	// reserve an additional page below the stack, which remains
+	// unmapped and catches stack overflows
+	viraddr = vma_alloc((npages+1)*PAGE_SIZE, VMA_READ|VMA_WRITE|VMA_CACHEABLE);
+	if (BUILTIN_EXPECT(!viraddr, 0))
+		return NULL;
+
+	phyaddr = get_pages(npages);
+	if (BUILTIN_EXPECT(!phyaddr, 0)) {
+		vma_free(viraddr, viraddr+(npages+1)*PAGE_SIZE);
 		return NULL;
-	// do we have a valid task id?
-	if (BUILTIN_EXPECT(id >= MAX_TASKS, 0))
+	}
+
+	err = page_map(viraddr+PAGE_SIZE, phyaddr, npages, PG_RW|PG_GLOBAL);
+	if (BUILTIN_EXPECT(err, 0)) {
+		vma_free(viraddr, viraddr+(npages+1)*PAGE_SIZE);
+		put_pages(phyaddr, npages);
 		return NULL;
+	}
+
+	return (void*) (viraddr+PAGE_SIZE);
+}
+
+/** @brief Set the bits [start, end) of a bitmap word by word */
+inline static void bitmap_set_range(size_t* map, size_t start, size_t end)
+{
+	size_t first = start / BITS_PER_WORD;
+	size_t last = (end - 1) / BITS_PER_WORD;
+	size_t mask_first = ~0UL << (start % BITS_PER_WORD);
+	size_t mask_last = ~0UL >> (BITS_PER_WORD - 1 - (end - 1) % BITS_PER_WORD);
+	size_t i;
+
+	if (BUILTIN_EXPECT(start >= end, 0))
+		return;
+
+	if (first == last) {
+		map[first] |= mask_first & mask_last;
+		return;
+	}
+
+	map[first] |= mask_first;
+	for (i=first+1; i<last; i++)
+		map[i] = ~0UL;
+	map[last] |= mask_last;
+}
+
+/** @brief Clear the bits [start, end) of a bitmap word by word */
+inline static void bitmap_clear_range(size_t* map, size_t start, size_t end)
+{
+	size_t first = start / BITS_PER_WORD;
+	size_t last = (end - 1) / BITS_PER_WORD;
+	size_t mask_first = ~0UL << (start % BITS_PER_WORD);
+	size_t mask_last = ~0UL >> (BITS_PER_WORD - 1 - (end - 1) % BITS_PER_WORD);
+	size_t i;
+
+	if (BUILTIN_EXPECT(start >= end, 0))
+		return;
+
+	if (first == last) {
+		map[first] &= ~(mask_first & mask_last);
+		return;
+	}
+
+	map[first] &= ~mask_first;
+	for (i=first+1; i<last; i++)
+		map[i] = 0;
+	map[last] &= ~mask_last;
+}
+
+/** @brief Find the first bit in [start, end), which is equal to set
+ *
+ * Whole words are skipped, the bit within a word is found by bsf.
+ *
+ * @return Index of the bit or end if there is none
+ */
+inline static size_t bitmap_find(const size_t* map, size_t start, size_t end, int set)
+{
+	size_t word;
+
+	while (start < end) {
+		word = set ? map[start / BITS_PER_WORD] : ~map[start / BITS_PER_WORD];
+		word &= ~0UL << (start % BITS_PER_WORD);
+		if (word) {
+			start = (start & ~(BITS_PER_WORD - 1)) + __builtin_ctzl(word);
+			break;
+		}
+
+		start = (start | (BITS_PER_WORD - 1)) + 1;
+	}
+
+	return (start < end) ? start : end;
+}
+
+/** @brief Push a free block of 2^order page frames to its list */
+inline static void frame_push(size_t pfn, uint32_t order)
+{
+	frame_t* frame = &frames[pfn];
+
+	frame->order = order;
+	frame->flags = FRAME_FREE;
+	frame->prev = FRAME_NONE;
+	frame->next = free_lists[order];
+	if (frame->next != FRAME_NONE)
+		frames[frame->next].prev = pfn;
+	free_lists[order] = pfn;
+}
+
+/** @brief Remove a free block of 2^order page frames from its list */
+inline static void frame_unlink(size_t pfn, uint32_t order)
+{
+	frame_t* frame = &frames[pfn];
+
+	if (frame->prev != FRAME_NONE)
+		frames[frame->prev].next = frame->next;
+	else
+		free_lists[order] = frame->next;
+	if (frame->next != FRAME_NONE)
+		frames[frame->next].prev = frame->prev;
+	frame->flags &= ~FRAME_FREE;
+}
+
+/** @brief Release a block of 2^order page frames and merge it with its free buddies */
+static void frame_free_block(size_t pfn, uint32_t order)
+{
+	size_t buddy;
 
-	return (void*) stack[id-1];
+	while (order < FRAME_MAX_ORDER) {
+		buddy = pfn ^ (1UL << order);
+		if (buddy >= nframes || !(frames[buddy].flags & FRAME_FREE) || frames[buddy].order != order)
+			break;
+
+		frame_unlink(buddy, order);
+		pfn &= ~(1UL << order);
+		order++;
+	}
+
+	frame_push(pfn, order);
 }
 
-inline static int page_marked(size_t i)
+/** @brief Release the page frames [start, end) as naturally aligned blocks */
+static void frame_free_range(size_t start, size_t end)
+{
+	uint32_t order;
+
+	while (start < end) {
+		order = 0;
+		while (order < FRAME_MAX_ORDER && !(start & (1UL << order)) && start + (2UL << order) <= end)
+			order++;
+
+		frame_free_block(start, order);
+		start += 1UL << order;
+	}
+}
+
+/** @brief Mark the physical memory [start, end) as used
+ *
+ * Used page frames are skipped word by word. Each free block, which
+ * overlaps the range, is split at the boundaries of the range.
+ */
+static void frame_reserve_range(size_t start, size_t end)
 {
-	size_t index = i >> 3;
-	size_t mod = i & 0x7;
+	size_t pfn = start >> PAGE_BITS;
+	size_t stop, head = 0, ret = 0;
+	uint32_t order;
+
+	end = (end + PAGE_SIZE - 1) >> PAGE_BITS;
+	if (end > nframes)
+		end = nframes;
+
+	while ((pfn = bitmap_find(used_map, pfn, end, 0)) < end) {
+		// search the free block, which contains the page frame
+		for (order=0; order<=FRAME_MAX_ORDER; order++) {
+			head = pfn & ~((1UL << order) - 1);
+			if ((frames[head].flags & FRAME_FREE) && (frames[head].order == order))
+				break;
+		}
+
+		if (BUILTIN_EXPECT(order > FRAME_MAX_ORDER, 0))
+			break;
+
+		stop = head + (1UL << order);
+		if (stop > end)
+			stop = end;
+
+		// give back the parts of the block outside of the range
+		frame_unlink(head, order);
+		frame_free_range(head, pfn);
+		frame_free_range(stop, head + (1UL << order));
+		bitmap_set_range(used_map, pfn, stop);
 
-	return  (bitmap[index] & (1 << mod));
+		ret += stop - pfn;
+		pfn = stop;
+	}
+
+	atomic_int32_add(&total_allocated_pages, ret);
+	atomic_int32_sub(&total_available_pages, ret);
 }
 
-inline static void page_set_mark(size_t i)
+/** @brief Allocate npages contiguous page frames (frame_lock has to be held)
+ *
+ * @return First page frame number or 0 on failure
+ */
+static size_t frame_alloc(size_t npages)
 {
-	size_t index = i >> 3;
-	size_t mod = i & 0x7;
+	size_t pfn;
+	uint32_t order, k;
+
+	for (order=0; (1UL << order) < npages; order++);
+	if (BUILTIN_EXPECT(order > FRAME_MAX_ORDER, 0))
+		return 0;
+
+	// search the smallest free block, which is large enough
+	for (k=order; k<=FRAME_MAX_ORDER && free_lists[k] == FRAME_NONE; k++);
+	if (BUILTIN_EXPECT(k > FRAME_MAX_ORDER, 0))
+		return 0;
+
+	pfn = free_lists[k];
+	frame_unlink(pfn, k);
+
+	// split the block down to the requested order...
+	while (k > order) {
+		k--;
+		frame_push(pfn + (1UL << k), k);
+	}
 
-	bitmap[index] = bitmap[index] | (1 << mod);
+	// ... and give back the unused page frames at its end
+	frame_free_range(pfn + npages, pfn + (1UL << order));
+
+	bitmap_set_range(used_map, pfn, pfn + npages);
+
+	return pfn;
 }
 
-inline static void page_clear_mark(size_t i)
+/** @brief Release npages page frames (frame_lock has to be held)
+ *
+ * @return Number of page frames, which were in use
+ */
+static size_t frame_release(size_t base, size_t npages)
 {
-	size_t index = i / 8;
-	size_t mod = i % 8;
+	size_t pfn = base, stop, ret = 0;
+	size_t end = base + npages;
 
-	bitmap[index] = bitmap[index] & ~(1 << mod);
+	if (end > nframes)
+		end = nframes;
+
+	// release all runs of used page frames
+	while ((pfn = bitmap_find(used_map, pfn, end, 1)) < end) {
+		stop = bitmap_find(used_map, pfn, end, 0);
+
+		bitmap_clear_range(used_map, pfn, stop);
+		frame_free_range(pfn, stop);
+
+		ret += stop - pfn;
+		pfn = stop;
+	}
+
+	return ret;
 }
 
 size_t get_pages(size_t npages)
 {
-	size_t cnt, off;
-	static size_t alloc_start = (size_t) -1;
+	size_t pfn, ret;
 
 	if (BUILTIN_EXPECT(!npages, 0))
 		return 0;
+
+	// boot time: page tables for the descriptors
+	if (BUILTIN_EXPECT(!frames, 0)) {
+		if (early_next + npages*PAGE_SIZE > early_end)
+			return 0;
+
+		ret = early_next;
+		early_next += npages*PAGE_SIZE;
+
+		return ret;
+	}
+
 	if (BUILTIN_EXPECT(npages > atomic_int32_read(&total_available_pages), 0))
 		return 0;
 
-	spinlock_lock(&bitmap_lock);
+	mutex_lock(&frame_lock);
+	pfn = frame_alloc(npages);
+	mutex_unlock(&frame_lock);
 
-	if (alloc_start == (size_t)-1)
-		 alloc_start = ((size_t) &kernel_end >> PAGE_BITS);
-	off = 1;
-	while (off <= BITMAP_SIZE*8 - npages) {
-		for (cnt=0; cnt<npages; cnt++) {
-			if (page_marked(((off+alloc_start)%(BITMAP_SIZE*8 - npages))+cnt))
-				goto next;
-		}
+	if (BUILTIN_EXPECT(!pfn, 0))
+		return 0;
 
-		off = (off+alloc_start) % (BITMAP_SIZE*8 - npages);
-		alloc_start = off+npages;
+	atomic_int32_add(&total_allocated_pages, npages);
+	atomic_int32_sub(&total_available_pages, npages);
 
-		for (cnt=0; cnt<npages; cnt++) {
-			page_set_mark(off+cnt);
-		}
+	return pfn << PAGE_BITS;
+}
+
+int put_pages(size_t phyaddr, size_t npages)
+{
+	size_t ret;
+
+	if (BUILTIN_EXPECT(!phyaddr, 0))
+		return -EINVAL;
+	if (BUILTIN_EXPECT(!npages, 0))
+		return -EINVAL;
+	if (BUILTIN_EXPECT(!frames, 0))
+		return -EINVAL;
+
+	mutex_lock(&frame_lock);
+	ret = frame_release(phyaddr >> PAGE_BITS, npages);
+	mutex_unlock(&frame_lock);
+
+	atomic_int32_sub(&total_allocated_pages, ret);
+	atomic_int32_add(&total_available_pages, ret);
+
+	return ret;
+}
+
+/** @brief Move a batch of page frames from a page cache back to the allocator */
+static void page_cache_drain(size_t* pages, uint32_t n)
+{
+	size_t ret = 0;
+	uint32_t i;
+
+	mutex_lock(&frame_lock);
+	for (i=0; i<n; i++)
+		ret += frame_release(pages[i] >> PAGE_BITS, 1);
+	mutex_unlock(&frame_lock);
+
+	atomic_int32_sub(&total_allocated_pages, ret);
+	atomic_int32_add(&total_available_pages, ret);
+}
+
+size_t get_page(void)
+{
+	size_t pages[PAGE_CACHE_BATCH];
+	page_cache_t* pcp;
+	size_t ret = 0;
+	uint32_t n;
+	uint8_t flags;
+
+	if (BUILTIN_EXPECT(!frames, 0))
+		return get_pages(1);
+
+	// fast path: take the hottest page frame of this core
+	flags = irq_nested_disable();
+	pcp = &page_caches[CORE_ID];
+	if (pcp->count) {
+		pcp->count--;
+		ret = pcp->pages[(pcp->first + pcp->count) & (PAGE_CACHE_SIZE-1)];
+	}
+	irq_nested_enable(flags);
+
+	if (ret)
+		return ret;
+
+	// slow path: refill the cache with a batch of page frames
+	mutex_lock(&frame_lock);
+	for (n=0; n<PAGE_CACHE_BATCH; n++) {
+		size_t pfn = frame_alloc(1);
+		if (!pfn)
+			break;
+		pages[n] = pfn << PAGE_BITS;
+	}
+	mutex_unlock(&frame_lock);
 
-		spinlock_unlock(&bitmap_lock);
+	if (BUILTIN_EXPECT(!n, 0))
+		return 0;
 
-		atomic_int32_add(&total_allocated_pages, npages);
-		atomic_int32_sub(&total_available_pages, npages);
+	atomic_int32_add(&total_allocated_pages, n);
+	atomic_int32_sub(&total_available_pages, n);
 
-		return off << PAGE_BITS;
+	ret = pages[--n];
 
-next:		off += cnt+1;
+	// untouched page frames are cold
+	flags = irq_nested_disable();
+	pcp = &page_caches[CORE_ID];
+	while (n && pcp->count < PAGE_CACHE_SIZE) {
+		pcp->first = (pcp->first - 1) & (PAGE_CACHE_SIZE-1);
+		pcp->pages[pcp->first] = pages[--n];
+		pcp->count++;
 	}
+	irq_nested_enable(flags);
 
-	spinlock_unlock(&bitmap_lock);
+	// the cache was refilled in the meantime
+	if (BUILTIN_EXPECT(n, 0))
+		page_cache_drain(pages, n);
+
+	return ret;
+}
+
+int share_page(size_t phyaddr)
+{
+	size_t pfn = phyaddr >> PAGE_BITS;
+
+	if (BUILTIN_EXPECT(!frames || pfn >= nframes, 0))
+		return -EINVAL;
+
+	atomic_int32_inc(&frames[pfn].shared);
 
 	return 0;
 }
 
-int put_pages(size_t phyaddr, size_t npages)
+int page_is_shared(size_t phyaddr)
+{
+	size_t pfn = phyaddr >> PAGE_BITS;
+
+	if (BUILTIN_EXPECT(!frames || pfn >= nframes, 0))
+		return 0;
+
+	return atomic_int32_read(&frames[pfn].shared) > 0;
+}
+
+/** @brief Drop a reference of a shared page frame
+ *
+ * @return
+ * - 1 if the page frame is still used by others
+ * - 0 if the caller was the last user
+ */
+static int page_unshare(size_t pfn)
+{
+	if (pfn >= nframes || !atomic_int32_read(&frames[pfn].shared))
+		return 0;
+
+	if (atomic_int32_dec(&frames[pfn].shared) >= 0)
+		return 1;
+
+	// we raced with the other user and were the last one
+	atomic_int32_set(&frames[pfn].shared, 0);
+
+	return 0;
+}
+
+/** @brief Put a page frame into the cache of this core
+ *
+ * If the cache is full, the coldest page frames go back to the allocator.
+ */
+static int page_cache_put(size_t phyaddr, int hot)
 {
-	size_t i, ret = 0;
-	size_t base = phyaddr >> PAGE_BITS;
+	size_t pages[PAGE_CACHE_BATCH];
+	page_cache_t* pcp;
+	uint32_t n = 0;
+	uint8_t flags;
 
 	if (BUILTIN_EXPECT(!phyaddr, 0))
 		return -EINVAL;
-	if (BUILTIN_EXPECT(!npages, 0))
+	if (BUILTIN_EXPECT(!frames, 0))
 		return -EINVAL;
 
-	spinlock_lock(&bitmap_lock);
+	if (page_unshare(phyaddr >> PAGE_BITS))
+		return 0;
 
-	for (i=0; i<npages; i++) {
-		if (page_marked(base+i)) {
-			page_clear_mark(base+i);
-			ret++;
+	flags = irq_nested_disable();
+	pcp = &page_caches[CORE_ID];
+	if (BUILTIN_EXPECT(pcp->count >= PAGE_CACHE_SIZE, 0)) {
+		for (n=0; n<PAGE_CACHE_BATCH; n++) {
+			pages[n] = pcp->pages[pcp->first];
+			pcp->first = (pcp->first + 1) & (PAGE_CACHE_SIZE-1);
+			pcp->count--;
 		}
 	}
 
-	spinlock_unlock(&bitmap_lock);
+	if (hot) {
+		pcp->pages[(pcp->first + pcp->count) & (PAGE_CACHE_SIZE-1)] = phyaddr & PAGE_MASK;
+	} else {
+		pcp->first = (pcp->first - 1) & (PAGE_CACHE_SIZE-1);
+		pcp->pages[pcp->first] = phyaddr & PAGE_MASK;
+	}
+	pcp->count++;
+	irq_nested_enable(flags);
 
-	atomic_int32_sub(&total_allocated_pages, ret);
-	atomic_int32_add(&total_available_pages, ret);
+	if (n)
+		page_cache_drain(pages, n);
+
+	return 1;
+}
+
+int put_page(size_t phyaddr)
+{
+	return page_cache_put(phyaddr, 1);
+}
+
+size_t get_zeroed_page(void)
+{
+	zero_pool_t* pool;
+	size_t ret = 0;
+	uint8_t flags;
+
+	flags = irq_nested_disable();
+	pool = &zero_pools[CORE_ID];
+	if (pool->count)
+		ret = pool->pages[--pool->count];
+	irq_nested_enable(flags);
 
 	return ret;
 }
 
-int copy_page(size_t pdest, size_t psrc)
+size_t get_zeroed_pages(size_t* pages, size_t npages)
 {
-	int err;
+	zero_pool_t* pool;
+	size_t i;
+	uint8_t flags;
+
+	flags = irq_nested_disable();
+	pool = &zero_pools[CORE_ID];
+	for (i=0; i<npages && pool->count; i++)
+		pages[i] = pool->pages[--pool->count];
+	irq_nested_enable(flags);
+
+	return i;
+}
+
+int zero_pool_fill(void)
+{
+	zero_pool_t* pool;
+	size_t phyaddr;
+	uint8_t flags;
+	int ret = 0;
+
+	if (BUILTIN_EXPECT(!frames, 0))
+		return 0;
+	if (zero_pools[CORE_ID].count >= ZERO_POOL_SIZE)
+		return 0;
+
+	phyaddr = get_page();
+	if (BUILTIN_EXPECT(!phyaddr, 0))
+		return 0;
+
+	page_zero(phyaddr);
 
-	static size_t viraddr;
-	if (!viraddr) { // statically allocate virtual memory area
-		viraddr = vma_alloc(2 * PAGE_SIZE, VMA_HEAP);
-		if (BUILTIN_EXPECT(!viraddr, 0))
-			return -ENOMEM;
+	flags = irq_nested_disable();
+	pool = &zero_pools[CORE_ID];
+	if (pool->count < ZERO_POOL_SIZE) {
+		pool->pages[pool->count++] = phyaddr;
+		ret = 1;
 	}
+	irq_nested_enable(flags);
 
-	// map pages
-	size_t vsrc = viraddr;
-	err = page_map(vsrc, psrc, 1, PG_GLOBAL|PG_RW);
-	if (BUILTIN_EXPECT(err, 0)) {
-		page_unmap(viraddr, 1);
+	if (!ret)
+		put_page(phyaddr);
+
+	return ret;
+}
+
+int put_page_cold(size_t phyaddr)
+{
+	return page_cache_put(phyaddr, 0);
+}
+
+/** @brief Add an available memory region (in bytes) */
+static void frame_add_region(uint64_t start, uint64_t end)
+{
+#ifdef CONFIG_X86_32
+	// without PAE, we are not able to use memory above 4 GiB
+	if (end > (1ULL << 32))
+		end = 1ULL << 32;
+#endif
+
+	start = (start + PAGE_SIZE - 1) >> PAGE_BITS;
+	end = end >> PAGE_BITS;
+
+	if (BUILTIN_EXPECT(start >= end || nregions >= MAX_REGIONS, 0))
+		return;
+
+	regions[nregions].start = start;
+	regions[nregions].end = end;
+	nregions++;
+
+	if (end > nframes)
+		nframes = end;
+}
+
+/** @brief Setup the descriptors of all page frames
+ *
+ * The descriptors are placed in the first available memory region behind
+ * the kernel, the Multiboot structures and the modules. They are mapped 1:1.
+ * The page tables for this mapping are taken from the page frames directly
+ * behind the descriptors.
+ */
+static int frame_init(void)
+{
+	size_t lowest = (size_t) &kernel_end;
+	size_t start = 0, npages, nslack, i;
+	uint32_t r;
+	int ret;
+
+	if (BUILTIN_EXPECT(!nregions, 0))
 		return -ENOMEM;
+
+	if (mb_info) {
+		if ((size_t) mb_info + sizeof(multiboot_info_t) > lowest)
+			lowest = (size_t) mb_info + sizeof(multiboot_info_t);
+		if ((mb_info->flags & MULTIBOOT_INFO_MEM_MAP) && (mb_info->mmap_addr + mb_info->mmap_length > lowest))
+			lowest = mb_info->mmap_addr + mb_info->mmap_length;
+
+		if (mb_info->flags & MULTIBOOT_INFO_MODS) {
+			multiboot_module_t* mmodule = (multiboot_module_t*) ((size_t) mb_info->mods_addr);
+
+			if (mb_info->mods_addr + mb_info->mods_count*sizeof(multiboot_module_t) > lowest)
+				lowest = mb_info->mods_addr + mb_info->mods_count*sizeof(multiboot_module_t);
+			for(i=0; i<mb_info->mods_count; i++) {
+				if (mmodule[i].mod_end > lowest)
+					lowest = mmodule[i].mod_end;
+			}
+		}
+	}
+	lowest = (lowest + PAGE_SIZE - 1) >> PAGE_BITS;
+
+	// descriptors, followed by the bitmap of used page frames
+	npages = ((nframes*sizeof(frame_t) + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1))
+		+ ((nframes + BITS_PER_WORD - 1) / BITS_PER_WORD) * sizeof(size_t);
+	npages = (npages + PAGE_SIZE - 1) >> PAGE_BITS;
+	nslack = (npages >> (PAGE_BITS - 3)) + 4;
+
+	for (r=0; r<nregions; r++) {
+		start = (regions[r].start > lowest) ? regions[r].start : lowest;
+		if ((start + npages + nslack <= regions[r].end)
+		    && ((start + npages + nslack) << PAGE_BITS) <= KERNEL_SPACE)
+			break;
 	}
 
-	size_t vdest = viraddr + PAGE_SIZE;
-	err = page_map(vdest, pdest, 1, PG_GLOBAL|PG_RW);
-	if (BUILTIN_EXPECT(err, 0)) {
-		page_unmap(viraddr + PAGE_SIZE, 1);
+	if (BUILTIN_EXPECT(r >= nregions, 0))
 		return -ENOMEM;
-	}
 
-	kprintf("copy_page: copy page frame from: %#lx (%#lx) to %#lx (%#lx)\n", vsrc, psrc, vdest, pdest); // TODO remove
+	early_next = (start + npages) << PAGE_BITS;
+	early_end = early_next + (nslack << PAGE_BITS);
+
+	ret = page_map(start << PAGE_BITS, start << PAGE_BITS, npages, PG_RW|PG_GLOBAL|PG_HUGE);
+	if (BUILTIN_EXPECT(ret, 0))
+		return ret;
+
+	frames = (frame_t*) (start << PAGE_BITS);
+	memset(frames, 0x00, nframes*sizeof(frame_t));
 
-	// copy the whole page
-	memcpy((void*) vdest, (void*) vsrc, PAGE_SIZE);
+	// all page frames are used, except the available memory regions
+	used_map = (size_t*) (((size_t) (frames + nframes) + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1));
+	memset(used_map, 0xff, ((nframes + BITS_PER_WORD - 1) / BITS_PER_WORD) * sizeof(size_t));
 
-	// householding
-	page_unmap(viraddr, 2);
+	for (r=0; r<nregions; r++) {
+		bitmap_clear_range(used_map, regions[r].start, regions[r].end);
+		frame_free_range(regions[r].start, regions[r].end);
+
+		atomic_int32_add(&total_pages, regions[r].end - regions[r].start);
+		atomic_int32_add(&total_available_pages, regions[r].end - regions[r].start);
+	}
+
+	// the descriptors and their page tables are in use
+	frame_reserve_range(start << PAGE_BITS, early_next);
 
 	return 0;
 }
@@ -197,12 +799,8 @@ int copy_page(size_t pdest, size_t psrc)
 int memory_init(void)
 {
 	unsigned int i;
-	size_t addr;
 	int ret = 0;
 
-	// mark all memory as used
-	memset(bitmap, 0xff, BITMAP_SIZE);
-
 	// enable paging and map Multiboot modules etc.
 	ret = page_init();
 	if (BUILTIN_EXPECT(ret, 0)) {
@@ -213,82 +811,56 @@ int memory_init(void)
 	// parse multiboot information for available memory
 	if (mb_info) {
 		if (mb_info->flags & MULTIBOOT_INFO_MEM_MAP) {
-			size_t end_addr;
 			multiboot_memory_map_t* mmap = (multiboot_memory_map_t*) ((size_t) mb_info->mmap_addr);
 			multiboot_memory_map_t* mmap_end = (void*) ((size_t) mb_info->mmap_addr + mb_info->mmap_length);
 
-			// mark available memory as free
 			while (mmap < mmap_end) {
-				if (mmap->type == MULTIBOOT_MEMORY_AVAILABLE) {
-					/* set the available memory as "unused" */
-					addr = mmap->addr;
-					end_addr = addr + mmap->len;
-
-					while ((addr < end_addr) && (addr < (BITMAP_SIZE*8*PAGE_SIZE))) {
-						if (page_marked(addr >> PAGE_BITS)) {
-							page_clear_mark(addr >> PAGE_BITS);
-							atomic_int32_inc(&total_pages);
-							atomic_int32_inc(&total_available_pages);
-						}
-						addr += PAGE_SIZE;
-					}
-				}
+				if (mmap->type == MULTIBOOT_MEMORY_AVAILABLE)
+					frame_add_region(mmap->addr, mmap->addr + mmap->len);
 				mmap = (multiboot_memory_map_t*) ((size_t) mmap + sizeof(uint32_t) + mmap->size);
 			}
 		} else if (mb_info->flags & MULTIBOOT_INFO_MEM) {
-			size_t page;
-			size_t pages_lower = mb_info->mem_lower >> 2; /* KiB to page number */
-			size_t pages_upper = mb_info->mem_upper >> 2;
-
-			for (page=0; page<pages_lower; page++)
-				page_clear_mark(page);
-
-			if (pages_upper > BITMAP_SIZE*8-256)
-				pages_upper = BITMAP_SIZE*8-256;
-
-			for (page=0; page<pages_upper; page++)
-				page_clear_mark(page + 256); /* 1 MiB == 256 pages offset */
-
-			atomic_int32_add(&total_pages, pages_lower + pages_upper);
-			atomic_int32_add(&total_available_pages, pages_lower + pages_upper);
+			frame_add_region(0, (uint64_t) mb_info->mem_lower << 10);
+			frame_add_region(1ULL << 20, (1ULL << 20) + ((uint64_t) mb_info->mem_upper << 10));
 		}
 		else {
 			kputs("Unable to initialize the memory management subsystem\n");
 			while (1) HALT;
 		}
+	}
 
-		// mark mb_info as used
-		page_set_mark((size_t) mb_info >> PAGE_BITS);
-		atomic_int32_inc(&total_allocated_pages);
-		atomic_int32_dec(&total_available_pages);
+	ret = frame_init();
+	if (BUILTIN_EXPECT(ret, 0)) {
+		kprintf("Failed to initialize the page frame allocator: %d\n", ret);
+		while (1) HALT;
+	}
+
+	// page frame 0 is never handed out, because 0 represents an error
+	frame_reserve_range(0, PAGE_SIZE);
 
+	if (mb_info) {
+		// mark mb_info as used
+		frame_reserve_range((size_t) mb_info, (size_t) mb_info + sizeof(multiboot_info_t));
 
 		if (mb_info->flags & MULTIBOOT_INFO_MODS) {
+			multiboot_module_t* mmodule = (multiboot_module_t*) ((size_t) mb_info->mods_addr);
+
 			// mark modules list as used
-			for(addr=mb_info->mods_addr; addr<mb_info->mods_addr+mb_info->mods_count*sizeof(multiboot_module_t); addr+=PAGE_SIZE) {
-				page_set_mark(addr >> PAGE_BITS);
-				atomic_int32_inc(&total_allocated_pages);
-				atomic_int32_dec(&total_available_pages);
-			}
+			frame_reserve_range(mb_info->mods_addr, mb_info->mods_addr + mb_info->mods_count*sizeof(multiboot_module_t));
 
 			// mark modules as used
-			multiboot_module_t* mmodule = (multiboot_module_t*) ((size_t) mb_info->mods_addr);
-			for(i=0; i<mb_info->mods_count; i++) {
-				for(addr=mmodule[i].mod_start; addr<mmodule[i].mod_end; addr+=PAGE_SIZE) {
-					page_set_mark(addr >> PAGE_BITS);
-					atomic_int32_inc(&total_allocated_pages);
-					atomic_int32_dec(&total_available_pages);
-				}
-			}
+			for(i=0; i<mb_info->mods_count; i++)
+				frame_reserve_range(mmodule[i].mod_start, mmodule[i].mod_end);
 		}
 	}
 
 	// mark kernel as used
-	for(addr=(size_t) &kernel_start; addr<(size_t) &kernel_end; addr+=PAGE_SIZE) {
-		page_set_mark(addr >> PAGE_BITS);
-		atomic_int32_inc(&total_allocated_pages);
-		atomic_int32_dec(&total_available_pages);
-	}
+	frame_reserve_range((size_t) &kernel_start, (size_t) &kernel_end);
+
+#if MAX_CORES > 1
+	// reserve the page for the boot code of the application processors
+	frame_reserve_range(SMP_SETUP_ADDR, SMP_SETUP_ADDR + PAGE_SIZE);
+#endif
 
 	ret = vma_init();
 	if (BUILTIN_EXPECT(ret, 0)) {
@@ -296,20 +868,11 @@ int memory_init(void)
 		return ret;
 	}
 
-	/*
-	 * Modules like the init ram disk are already loaded.
-	 * Therefore, we set these pages as used.
-	 */
-	if (mb_info && (mb_info->flags & MULTIBOOT_INFO_MODS)) {
-		multiboot_module_t* mmodule = (multiboot_module_t*) ((size_t) mb_info->mods_addr);
-		for(i=0; i<mb_info->mods_count; i++) {
-			for(addr=mmodule[i].mod_start; addr<mmodule[i].mod_end; addr+=PAGE_SIZE) {
-				page_set_mark(addr >> PAGE_BITS);
-				atomic_int32_inc(&total_allocated_pages);
-				atomic_int32_dec(&total_available_pages);
-			}
-		}
-	}
+	// add the page frame descriptors
+	ret = vma_add((size_t) frames, PAGE_FLOOR((size_t) (used_map + (nframes + BITS_PER_WORD - 1) / BITS_PER_WORD)),
+		VMA_READ|VMA_WRITE|VMA_CACHEABLE);
+	if (BUILTIN_EXPECT(ret, 0))
+		kprintf("Failed to add the VMA of the page frame descriptors: %d\n", ret);
 
 	return ret;
 }
@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2026
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the University nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <eduos/stdio.h>
+#include <eduos/stdlib.h>
+#include <eduos/malloc.h>
+#include <eduos/slab.h>
+#include <eduos/mutex.h>
+#include <eduos/errno.h>
+#include <asm/page.h>
+#include <asm/irqflags.h>
+
+/// Number of objects, which are moved between a magazine and the slabs at once
+#define KMEM_BATCH	(KMEM_MAGAZINE_SIZE/2)
+
+/** @brief Determine object size and slab size of a cache
+ *
+ * Objects of at least a cache line are aligned to cache lines to
+ * avoid false sharing. Smaller objects are aligned to pointers.
+ */
+static int kmem_cache_setup(kmem_cache_t* cache)
+{
+	size_t align = (cache->size >= CACHE_LINE) ? CACHE_LINE : sizeof(void*);
+	size_t size = (cache->size + align - 1) & ~(align - 1);
+	size_t offset = (sizeof(kmem_slab_t) + align - 1) & ~(align - 1);
+	uint32_t order = PAGE_BITS;
+
+	if (BUILTIN_EXPECT(!size, 0))
+		return -EINVAL;
+
+	while (order < BUDDY_ALLOC && ((1UL << order) - offset) / size < KMEM_SLAB_OBJS)
+		order++;
+
+	if (BUILTIN_EXPECT((1UL << order) - offset < size, 0))
+		return -EINVAL;
+
+	cache->size = size;
+	cache->offset = offset;
+	cache->order = order;
+
+	return 0;
+}
+
+/** @brief Allocate a new slab and link it to the list of partial slabs */
+static kmem_slab_t* kmem_slab_grow(kmem_cache_t* cache)
+{
+	kmem_slab_t* slab = (kmem_slab_t*) buddy_alloc(cache->order);
+	size_t obj, end;
+
+	if (BUILTIN_EXPECT(!slab, 0))
+		return NULL;
+
+	slab->cache = cache;
+	slab->inuse = 0;
+	slab->free = NULL;
+
+	// build the free list backwards => objects are handed out in address order
+	end = (size_t) slab + (1UL << cache->order);
+	obj = (size_t) slab + cache->offset;
+	obj += ((end - obj) / cache->size - 1) * cache->size;
+	for (; obj >= (size_t) slab + cache->offset; obj -= cache->size) {
+		*((void**) obj) = slab->free;
+		slab->free = (void*) obj;
+	}
+
+	slab->prev = NULL;
+	slab->next = cache->partial;
+	if (cache->partial)
+		cache->partial->prev = slab;
+	cache->partial = slab;
+	cache->slabs++;
+
+	return slab;
+}
+
+/** @brief Remove a slab from the list of partial slabs */
+static inline void kmem_slab_unlink(kmem_cache_t* cache, kmem_slab_t* slab)
+{
+	if (slab->prev)
+		slab->prev->next = slab->next;
+	else
+		cache->partial = slab->next;
+	if (slab->next)
+		slab->next->prev = slab->prev;
+}
+
+/** @brief Take up to n objects from the slabs
+ *
+ * @return Number of objects, which are stored in objs
+ */
+static uint32_t kmem_slab_get(kmem_cache_t* cache, void** objs, uint32_t n)
+{
+	kmem_slab_t* slab;
+	uint32_t i = 0;
+
+	mutex_lock(&cache->lock);
+
+	if (BUILTIN_EXPECT(!cache->order && kmem_cache_setup(cache), 0))
+		goto out;
+
+	while (i < n) {
+		slab = cache->partial;
+		if (!slab) {
+			// don't grow the cache for a refill
+			if (i)
+				break;
+
+			slab = kmem_slab_grow(cache);
+			if (BUILTIN_EXPECT(!slab, 0))
+				break;
+		}
+
+		objs[i++] = slab->free;
+		slab->free = *((void**) slab->free);
+		slab->inuse++;
+
+		if (!slab->free)
+			kmem_slab_unlink(cache, slab);
+	}
+
+out:
+	mutex_unlock(&cache->lock);
+
+	return i;
+}
+
+/** @brief Give n objects back to their slabs
+ *
+ * Empty slabs are returned to the buddy system, except the last
+ * partial one to avoid thrashing.
+ */
+static void kmem_slab_put(kmem_cache_t* cache, void** objs, uint32_t n)
+{
+	kmem_slab_t* slab;
+	uint32_t i;
+
+	mutex_lock(&cache->lock);
+
+	for (i=0; i<n; i++) {
+		slab = (kmem_slab_t*) ((size_t) objs[i] & ~((1UL << cache->order) - 1));
+
+		if (!slab->free) {
+			// the slab was full => link it to the partial slabs
+			slab->prev = NULL;
+			slab->next = cache->partial;
+			if (cache->partial)
+				cache->partial->prev = slab;
+			cache->partial = slab;
+		}
+
+		*((void**) objs[i]) = slab->free;
+		slab->free = objs[i];
+		slab->inuse--;
+
+		if (!slab->inuse && (slab->prev || slab->next)) {
+			kmem_slab_unlink(cache, slab);
+			buddy_free(slab, cache->order);
+			cache->slabs--;
+		}
+	}
+
+	mutex_unlock(&cache->lock);
+}
+
+int kmem_cache_init(kmem_cache_t* cache, const char* name, size_t size)
+{
+	uint32_t i;
+
+	if (BUILTIN_EXPECT(!cache, 0))
+		return -EINVAL;
+
+	cache->name = name;
+	cache->size = size;
+	cache->slabs = 0;
+	cache->partial = NULL;
+	for (i=0; i<MAX_CORES; i++)
+		cache->cpu[i].count = 0;
+	mutex_init(&cache->lock);
+
+	return kmem_cache_setup(cache);
+}
+
+/** @brief Binary size exponent of a dynamically created cache
+ *
+ * kmalloc() doesn't preserve the alignment of the magazines. Therefore,
+ * the caches are taken directly from the buddy system.
+ */
+static inline int kmem_cache_exp(void)
+{
+	int exp = BUDDY_MIN;
+
+	while ((1UL << exp) < sizeof(kmem_cache_t))
+		exp++;
+
+	return exp;
+}
+
+kmem_cache_t* kmem_cache_create(const char* name, size_t size)
+{
+	kmem_cache_t* cache = buddy_alloc(kmem_cache_exp());
+
+	if (BUILTIN_EXPECT(!cache, 0))
+		return NULL;
+
+	if (BUILTIN_EXPECT(kmem_cache_init(cache, name, size), 0)) {
+		buddy_free(cache, kmem_cache_exp());
+		return NULL;
+	}
+
+	return cache;
+}
+
+int kmem_cache_destroy(kmem_cache_t* cache)
+{
+	kmem_slab_t* slab;
+	uint32_t i;
+
+	if (BUILTIN_EXPECT(!cache, 0))
+		return -EINVAL;
+
+	// nobody uses the cache anymore => we are allowed to drain all magazines
+	for (i=0; i<MAX_CORES; i++) {
+		kmem_slab_put(cache, cache->cpu[i].objs, cache->cpu[i].count);
+		cache->cpu[i].count = 0;
+	}
+
+	mutex_lock(&cache->lock);
+	slab = cache->partial;
+	if (BUILTIN_EXPECT(cache->slabs > 1 || (slab && slab->inuse), 0)) {
+		mutex_unlock(&cache->lock);
+		kprintf("kmem_cache_destroy: cache %s is still in use\n", cache->name);
+		return -EBUSY;
+	}
+
+	if (slab)
+		buddy_free(slab, cache->order);
+	cache->partial = NULL;
+	cache->slabs = 0;
+	mutex_unlock(&cache->lock);
+
+	mutex_destroy(&cache->lock);
+	buddy_free(cache, kmem_cache_exp());
+
+	return 0;
+}
+
+void* kmem_cache_alloc(kmem_cache_t* cache)
+{
+	void* objs[KMEM_BATCH+1];
+	kmem_magazine_t* mag;
+	void* obj = NULL;
+	uint32_t n;
+	uint8_t flags;
+
+	if (BUILTIN_EXPECT(!cache, 0))
+		return NULL;
+
+	// fast path: the magazine of this core isn't empty
+	flags = irq_nested_disable();
+	mag = &cache->cpu[CORE_ID];
+	if (mag->count)
+		obj = mag->objs[--mag->count];
+	irq_nested_enable(flags);
+
+	if (obj)
+		return obj;
+
+	// slow path: refill the magazine from the slabs
+	n = kmem_slab_get(cache, objs, KMEM_BATCH+1);
+	if (BUILTIN_EXPECT(!n, 0))
+		return NULL;
+	obj = objs[--n];
+
+	flags = irq_nested_disable();
+	mag = &cache->cpu[CORE_ID];
+	while (n && mag->count < KMEM_MAGAZINE_SIZE)
+		mag->objs[mag->count++] = objs[--n];
+	irq_nested_enable(flags);
+
+	// the magazine was refilled in the meantime
+	if (BUILTIN_EXPECT(n, 0))
+		kmem_slab_put(cache, objs, n);
+
+	return obj;
+}
+
+void kmem_cache_free(kmem_cache_t* cache, void* obj)
+{
+	void* objs[KMEM_BATCH+1];
+	kmem_magazine_t* mag;
+	uint32_t n = 0;
+	uint8_t flags;
+
+	if (BUILTIN_EXPECT(!cache || !obj, 0))
+		return;
+
+	flags = irq_nested_disable();
+	mag = &cache->cpu[CORE_ID];
+	if (BUILTIN_EXPECT(mag->count >= KMEM_MAGAZINE_SIZE, 0)) {
+		// slow path: move half of the magazine back to the slabs
+		while (n < KMEM_BATCH)
+			objs[n++] = mag->objs[--mag->count];
+		objs[n++] = obj;
+	} else mag->objs[mag->count++] = obj;
+	irq_nested_enable(flags);
+
+	if (n)
+		kmem_slab_put(cache, objs, n);
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2026
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the University nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <eduos/stddef.h>
+#include <eduos/string.h>
+#include <eduos/tasks_types.h>
+#include <eduos/rwlock.h>
+#include <eduos/errno.h>
+#include <eduos/uaccess.h>
+
+/** @brief Check the range against a single VMA
+ * @return Address behind the part of [start, end), which vma covers
+ */
+static inline size_t vma_covers(vma_t* vma, size_t start, size_t end, uint32_t flags)
+{
+	if (!vma || (vma->start > start) || (vma->end <= start))
+		return start;
+	if ((vma->flags & flags) != flags)
+		return start;
+
+	return (vma->end < end) ? vma->end : end;
+}
+
+int access_user(const void* addr, size_t len, uint32_t flags)
+{
+	task_t* task = per_core(current_task);
+	size_t start = (size_t) addr;
+	size_t end = start + len;
+	size_t next;
+	vma_t* vma;
+
+	flags = (flags & (VMA_READ|VMA_WRITE)) | VMA_USER;
+
+	if (BUILTIN_EXPECT(!len, 0))
+		return 0;
+	if (BUILTIN_EXPECT((start < VMA_USER_MIN) || (end > VMA_USER_MAX) || (end < start), 0))
+		return -EFAULT;
+
+	read_lock(&task->vma_lock);
+
+	// adjacent VMAs may cover the buffer together
+	while (start < end) {
+		next = vma_covers(task->heap, start, end, flags);
+
+		for (vma=task->vma_list; (vma) && (next == start); vma=vma->next)
+			next = vma_covers(vma, start, end, flags);
+
+		if (next == start)
+			break;
+		start = next;
+	}
+
+	read_unlock(&task->vma_lock);
+
+	return (start < end) ? -EFAULT : 0;
+}
+
+size_t copy_from_user(void* dest, const void* src, size_t n)
+{
+	if (BUILTIN_EXPECT(access_user(src, n, VMA_READ), 0))
+		return n;
+
+	return copy_user(dest, src, n);
+}
+
+size_t copy_to_user(void* dest, const void* src, size_t n)
+{
+	if (BUILTIN_EXPECT(access_user(dest, n, VMA_WRITE), 0))
+		return n;
+
+	return copy_user(dest, src, n);
+}
+
+ssize_t strncpy_from_user(char* dest, const char* src, size_t n)
+{
+	size_t addr = (size_t) src;
+	size_t i, len = 0, chunk;
+
+	if (BUILTIN_EXPECT(!n, 0))
+		return -ENAMETOOLONG;
+
+	// copy page by page, the string may end in front of an invalid page
+	while (len < n) {
+		chunk = PAGE_FLOOR(addr + 1) - addr;
+		if (chunk > n - len)
+			chunk = n - len;
+
+		if (BUILTIN_EXPECT(copy_from_user(dest + len, (void*) addr, chunk), 0))
+			return -EFAULT;
+
+		for (i=0; i<chunk; i++) {
+			if (!dest[len + i])
+				return len + i;
+		}
+
+		len += chunk;
+		addr += chunk;
+	}
+
+	// the string doesn't fit into dest
+	dest[n-1] = '\0';
+
+	return -ENAMETOOLONG;
+}
@@ -30,6 +30,7 @@
 #include <eduos/stdio.h>
 #include <eduos/tasks_types.h>
 #include <eduos/spinlock.h>
+#include <eduos/rwlock.h>
 #include <eduos/errno.h>
 #include <asm/multiboot.h>
 
@@ -48,7 +49,7 @@ extern const void kernel_end;
  */
 static vma_t vma_boot = { VMA_KERN_MIN, VMA_KERN_MIN, VMA_HEAP };
 static vma_t* vma_list = &vma_boot;
-static spinlock_t vma_lock = SPINLOCK_INIT;
+static rwlock_t vma_lock = RWLOCK_INIT;
 
 // TODO: we might move the architecture specific VMA regions to a
 //       seperate function arch_vma_init()
@@ -70,6 +71,14 @@ int vma_init(void)
 		goto out;
 #endif
 
+#if MAX_CORES > 1
+	// add SMP boot page
+	ret = vma_add(SMP_SETUP_ADDR, SMP_SETUP_ADDR + PAGE_SIZE,
+		VMA_READ|VMA_WRITE|VMA_EXECUTE|VMA_CACHEABLE);
+	if (BUILTIN_EXPECT(ret, 0))
+		goto out;
+#endif
+
 	// add Multiboot structures as modules
 	if (mb_info) {
 		ret = vma_add(PAGE_CEIL((size_t) mb_info),
@@ -105,8 +114,8 @@ out:
 
 size_t vma_alloc(size_t size, uint32_t flags)
 {
-	task_t* task = current_task;
-	spinlock_t* lock;
+	task_t* task = per_core(current_task);
+	rwlock_t* lock;
 	vma_t** list;
 
 	//kprintf("vma_alloc: size = %#lx, flags = %#x\n", size, flags);
@@ -127,7 +136,7 @@ size_t vma_alloc(size_t size, uint32_t flags)
 		lock = &vma_lock;
 	}
 
-	spinlock_lock(lock);
+	write_lock(lock);
 
 	// first fit search for free memory area
 	vma_t* pred = NULL;  // vma before current gap
@@ -144,7 +153,7 @@ size_t vma_alloc(size_t size, uint32_t flags)
 	} while (pred || succ);
 
 fail:
-	spinlock_unlock(lock);	// we were unlucky to find a free gap
+	write_unlock(lock);	// we were unlucky to find a free gap
 
 	return 0;
 
@@ -171,15 +180,15 @@ found:
 			*list = new;
 	}
 
-	spinlock_unlock(lock);
+	write_unlock(lock);
 
 	return start;
 }
 
 int vma_free(size_t start, size_t end)
 {
-	task_t* task = current_task;
-	spinlock_t* lock;
+	task_t* task = per_core(current_task);
+	rwlock_t* lock;
 	vma_t* vma;
 	vma_t** list = NULL;
 
@@ -200,7 +209,7 @@ int vma_free(size_t start, size_t end)
 	if (BUILTIN_EXPECT(!list || !*list, 0))
 		return -EINVAL;
 
-	spinlock_lock(lock);
+	write_lock(lock);
 
 	// search vma
 	vma = *list;
@@ -210,7 +219,7 @@ int vma_free(size_t start, size_t end)
 	}
 
 	if (BUILTIN_EXPECT(!vma, 0)) {
-		spinlock_unlock(lock);
+		write_unlock(lock);
 		return -EINVAL;
 	}
 
@@ -231,7 +240,7 @@ int vma_free(size_t start, size_t end)
 	else {
 		vma_t* new = kmalloc(sizeof(vma_t));
 		if (BUILTIN_EXPECT(!new, 0)) {
-			spinlock_unlock(lock);
+			write_unlock(lock);
 			return -ENOMEM;
 		}
 
@@ -244,15 +253,15 @@ int vma_free(size_t start, size_t end)
 		new->prev = vma;
 	}
 
-	spinlock_unlock(lock);
+	write_unlock(lock);
 
 	return 0;
 }
 
 int vma_add(size_t start, size_t end, uint32_t flags)
 {
-	task_t* task = current_task;
-	spinlock_t* lock;
+	task_t* task = per_core(current_task);
+	rwlock_t* lock;
 	vma_t** list;
 
 	if (BUILTIN_EXPECT(start >= end, 0))
@@ -277,7 +286,7 @@ int vma_add(size_t start, size_t end, uint32_t flags)
 
 	//kprintf("vma_add: start = %#lx, end = %#lx, flags = %#x\n", start, end, flags);
 
-	spinlock_lock(lock);
+	write_lock(lock);
 
 	// search gap
 	vma_t* pred = NULL;
@@ -293,14 +302,14 @@ int vma_add(size_t start, size_t end, uint32_t flags)
 	}
 
 	if (BUILTIN_EXPECT(*list && !pred && !succ, 0)) {
-		spinlock_unlock(lock);
+		write_unlock(lock);
 		return -EINVAL;
 	}
 
 	// insert new VMA
 	vma_t* new = kmalloc(sizeof(vma_t));
 	if (BUILTIN_EXPECT(!new, 0)) {
-		spinlock_unlock(lock);
+		write_unlock(lock);
 		return -ENOMEM;
 	}
 
@@ -317,25 +326,25 @@ int vma_add(size_t start, size_t end, uint32_t flags)
 	else
 		*list = new;
 
-	spinlock_unlock(lock);
+	write_unlock(lock);
 
 	return 0;
 }
 
 int copy_vma_list(task_t* src, task_t* dest)
 {
-	spinlock_init(&dest->vma_lock);
+	rwlock_init(&dest->vma_lock);
 
-	spinlock_lock(&src->vma_lock);
-	spinlock_lock(&dest->vma_lock);
+	read_lock(&src->vma_lock);
+	write_lock(&dest->vma_lock);
 
 	vma_t* last = NULL;
 	vma_t* old;
 	for (old=src->vma_list; old; old=old->next) {
 		vma_t *new = kmalloc(sizeof(vma_t));
 		if (BUILTIN_EXPECT(!new, 0)) {
-			spinlock_unlock(&dest->vma_lock);
-			spinlock_unlock(&src->vma_lock);
+			write_unlock(&dest->vma_lock);
+			read_unlock(&src->vma_lock);
 			return -ENOMEM;
 		}
 
@@ -352,8 +361,8 @@ int copy_vma_list(task_t* src, task_t* dest)
 		last = new;
 	}
 
-	spinlock_unlock(&dest->vma_lock);
-	spinlock_unlock(&src->vma_lock);
+	write_unlock(&dest->vma_lock);
+	read_unlock(&src->vma_lock);
 
 	return 0;
 }
@@ -362,14 +371,14 @@ int drop_vma_list(task_t *task)
 {
 	vma_t* vma;
 
-	spinlock_lock(&task->vma_lock);
+	write_lock(&task->vma_lock);
 
 	while ((vma = task->vma_list)) {
 		task->vma_list = vma->next;
 		kfree(vma);
 	}
 
-	spinlock_unlock(&task->vma_lock);
+	write_unlock(&task->vma_lock);
 
 	return 0;
 }
@@ -386,15 +395,15 @@ void vma_dump(void)
 		}
 	}
 
-	task_t* task = current_task;
+	task_t* task = per_core(current_task);
 
 	kputs("Kernelspace VMAs:\n");
-	spinlock_lock(&vma_lock);
+	read_lock(&vma_lock);
 	print_vma(vma_list);
-	spinlock_unlock(&vma_lock);
+	read_unlock(&vma_lock);
 
 	kputs("Userspace VMAs:\n");
-	spinlock_lock(&task->vma_lock);
+	read_lock(&task->vma_lock);
 	print_vma(task->vma_list);
-	spinlock_unlock(&task->vma_lock);
+	read_unlock(&task->vma_lock);
 }
@@ -30,20 +30,57 @@
 #include <_syslist.h>
 #include <sys/time.h>
 #include <sys/times.h>
+#include <time.h>
 #include <errno.h>
 #undef errno
 extern int errno;
 #include "warning.h"
+#include "vclock.h"
 
-struct timeval;
-
+/*
+ * eduOS doesn't provide a real time clock. Hence, the time of day
+ * starts at boot time. It's read from the clock page without a
+ * system call.
+ */
 int
 _DEFUN (_gettimeofday, (ptimeval, ptimezone),
         struct timeval  *ptimeval  _AND
         void *ptimezone)
 {
-  errno = ENOSYS;
-  return -1;
+	uint64_t usec;
+
+	if (ptimeval) {
+		usec = vclock_usec();
+		ptimeval->tv_sec = usec / 1000000;
+		ptimeval->tv_usec = usec % 1000000;
+	}
+
+	return 0;
 }
 
-stub_warning(_gettimeofday)
+#if defined(_POSIX_TIMERS)
+int
+_DEFUN (clock_gettime, (clock_id, tp),
+        clockid_t clock_id _AND
+        struct timespec *tp)
+{
+	uint64_t usec;
+
+	switch (clock_id) {
+	case CLOCK_REALTIME:
+#if defined(CLOCK_MONOTONIC)
+	case CLOCK_MONOTONIC:
+#endif
+		break;
+	default:
+		errno = EINVAL;
+		return -1;
+	}
+
+	usec = vclock_usec();
+	tp->tv_sec = usec / 1000000;
+	tp->tv_nsec = (usec % 1000000) * 1000;
+
+	return 0;
+}
+#endif
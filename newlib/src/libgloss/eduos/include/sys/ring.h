@@ -0,0 +1,84 @@
+#ifndef _SYS_RING_H
+# define _SYS_RING_H
+
+/*
+ * System call ring, which is shared between the task and the kernel.
+ * A task queues several system calls with ring_prep() and hands them
+ * over with a single trap (ring_enter). The kernel stores the results
+ * in the completion queue.
+ *
+ * Keep this layout in sync with the kernel (include/eduos/ring.h).
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/* number of entries in each queue (power of two) */
+#define RING_ENTRIES	32
+#define RING_MASK	(RING_ENTRIES-1)
+
+typedef struct ring_sqe {
+	size_t nr;		/* system call number */
+	size_t arg[5];		/* arguments of the system call */
+	size_t user_data;	/* tag, which is copied into the completion entry */
+} ring_sqe_t;
+
+typedef struct ring_cqe {
+	size_t user_data;	/* tag of the submission entry */
+	ssize_t res;		/* return value of the system call */
+} ring_cqe_t;
+
+typedef struct ring {
+	volatile uint32_t sq_head;	/* advanced by the kernel */
+	volatile uint32_t sq_tail;	/* advanced by the task */
+	volatile uint32_t cq_head;	/* advanced by the task */
+	volatile uint32_t cq_tail;	/* advanced by the kernel */
+	ring_sqe_t sqes[RING_ENTRIES];
+	ring_cqe_t cqes[RING_ENTRIES];
+} ring_t;
+
+/* maps the ring of the calling task and stores its address in *ring */
+int ring_setup (ring_t **ring);
+/* executes up to to_submit queued system calls, returns their number */
+int ring_enter (unsigned int to_submit);
+
+/* queues a system call, returns -1 if the submission queue is full */
+static inline int ring_prep (ring_t *ring, size_t nr, size_t arg0, size_t arg1,
+	size_t arg2, size_t user_data)
+{
+	ring_sqe_t *sqe;
+
+	if (ring->sq_tail - ring->sq_head >= RING_ENTRIES)
+		return -1;
+
+	sqe = ring->sqes + (ring->sq_tail & RING_MASK);
+	sqe->nr = nr;
+	sqe->arg[0] = arg0;
+	sqe->arg[1] = arg1;
+	sqe->arg[2] = arg2;
+	sqe->arg[3] = sqe->arg[4] = 0;
+	sqe->user_data = user_data;
+	/* the entry has to be complete, before the kernel sees it */
+	__asm__ __volatile__ ("" ::: "memory");
+	ring->sq_tail++;
+
+	return 0;
+}
+
+/* returns the next completion entry or NULL */
+static inline ring_cqe_t *ring_peek (ring_t *ring)
+{
+	if (ring->cq_head == ring->cq_tail)
+		return NULL;
+
+	return ring->cqes + (ring->cq_head & RING_MASK);
+}
+
+/* releases the entry returned by ring_peek() */
+static inline void ring_seen (ring_t *ring)
+{
+	ring->cq_head++;
+}
+
+#endif
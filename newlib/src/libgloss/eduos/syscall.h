@@ -64,6 +64,8 @@ extern "C" {
 #define __NR_stat		30
 #define __NR_dup		31
 #define __NR_dup2		32
+#define __NR_ring_setup		33
+#define __NR_ring_enter		34
 
 #define _STR(token)             #token
 #define _SYSCALLSTR(x)          "int $" _STR(x) " "
@@ -89,18 +91,13 @@ syscall(int nr, unsigned long arg0, unsigned long arg1, unsigned long arg2,
 	unsigned long arg3, unsigned long arg4)
 {
 	long res;
+	register unsigned long r10 asm("r10") = arg3;
+	register unsigned long r8 asm("r8") = arg4;
 
-#if 0
-	asm volatile ("mov %5, %%r8; mov %6, %%r9" _SYSCALLSTR(INT_SYSCALL)
+	asm volatile ("syscall"
 			: "=a" (res)
-			: "D" (nr), "S" (arg0), "d" (arg1), "c" (arg2), "m" (arg3), "m" (arg4)
-			: "memory", "cc", "%r8", "%r9");
-#else
-	asm volatile ("mov %5, %%r8; mov %6, %%r9; syscall"
-			: "=a" (res)
-			: "D" (nr), "S" (arg0), "d" (arg1), "c" (arg2), "m" (arg3), "m" (arg4)
-			: "memory", "cc", "%r8", "%r9");
-#endif
+			: "0" (nr), "D" (arg0), "S" (arg1), "d" (arg2), "r" (r10), "r" (r8)
+			: "memory", "cc", "%rcx", "%r11");
 
 	return res;
 }
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2026
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the University nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __VCLOCK_H__
+#define __VCLOCK_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The kernel maps a read-only clock page into each task.
+ * Keep this layout in sync with the kernel (include/eduos/time.h).
+ */
+typedef struct vclock {
+	volatile uint32_t seq;	/* sequence counter, odd during an update */
+	uint32_t freq;		/* TSC frequency in MHz or 0 */
+	uint64_t ticks;		/* number of timer ticks */
+	uint64_t tsc;		/* TSC value at the last tick */
+	uint32_t hz;		/* number of ticks per second */
+} vclock_t;
+
+#if __x86_64__
+#define VCLOCK_ADDR	0xFFFFFE7FFFFFF000ULL
+#elif __i386__
+#define VCLOCK_ADDR	0xFF3FF000UL
+#else
+#error unsupported architecture
+#endif
+
+inline static uint64_t vclock_rdtsc(void)
+{
+	uint32_t lo, hi;
+
+	__asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+
+	return ((uint64_t) hi << 32) | lo;
+}
+
+/* uptime in microseconds, without a system call */
+inline static uint64_t vclock_usec(void)
+{
+	const vclock_t *vc = (const vclock_t *) VCLOCK_ADDR;
+	uint64_t ticks, tsc, now, usec;
+	uint32_t seq, freq, hz;
+
+	do {
+		/* the kernel updates the page */
+		while ((seq = vc->seq) & 1)
+			__asm__ __volatile__ ("pause");
+
+		/* x86 doesn't reorder loads, but the compiler does */
+		__asm__ __volatile__ ("" ::: "memory");
+		ticks = vc->ticks;
+		tsc = vc->tsc;
+		freq = vc->freq;
+		hz = vc->hz;
+		now = vclock_rdtsc();
+		__asm__ __volatile__ ("" ::: "memory");
+	} while (seq != vc->seq);
+
+	usec = ticks * (1000000 / hz);
+	if (freq && (now > tsc))
+		usec += (now - tsc) / freq;
+
+	return usec;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif